@@ -12,12 +12,19 @@ shopt -s nullglob
 LFLAGS="`pkg-config --libs glfw3 libpng openal sndfile` -ldl"
 if [ 0 -ne $? ]; then exit; fi;
 
+# EGL is only for `--bench` and `--headless`, which just complain and quit without it
+EGL_FLAGS=""
+if pkg-config --exists egl; then
+	LFLAGS="$LFLAGS `pkg-config --libs egl`"
+	EGL_FLAGS="-DHAVE_EGL"
+fi
+
 # `rdynamic` exports many symbols, which we need so that
 # stuff in shared object files can use our symbols.
 # `-ldl` is included again since I also use it myself, separate from GLFW3.
 DL_STUFF="-rdynamic -ldl"
 
-g++ -std=c++20 -fdiagnostics-color -Wall -Wshadow -Wno-switch -Wno-format-truncation -Wno-invalid-offsetof -O2 -g $DL_STUFF "$@" \
+g++ -std=c++20 -fdiagnostics-color -Wall -Wshadow -Wno-switch -Wno-format-truncation -Wno-invalid-offsetof -O2 -g $DL_STUFF $EGL_FLAGS "$@" \
 	src/{,lv/,comp/,tasks/}*.{c,cpp} \
 	-I./includes/ \
 	$LFLAGS -pthread -lm -lGL -o game \
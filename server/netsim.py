@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+# Sits between clients and the real server, making the connection worse on purpose.
+# Every chunk of data (in either direction) is held for a while before being passed along.
+
+import sys
+import time
+import random
+import asyncio
+
+usage = """Usage: listen_port server_port [options]
+
+Options (all times in ms, applied separately to each direction):
+  --delay D        base one-way delay (default 30)
+  --jitter J       extra random delay, uniform in [0, J] (default 10)
+  --reorder P      chance (0-1) a chunk is held back one extra frame (default 0)
+  --stall-every S  average seconds between stalls, 0 for none (default 0)
+  --stall-ms M     how long a stall freezes a direction (default 500)
+  --seed N         random seed, so runs can be repeated
+
+This is TCP, so bytes can't actually arrive out of order. A "reordered" chunk is
+instead held long enough for the next one to catch up and they arrive together,
+which is what reordering of frames looks like to the client: one late, then a pair. Stalls are the same thing
+but for everything in flight, like a wifi hiccup."""
+
+opts = {
+    'delay': 30.0,
+    'jitter': 10.0,
+    'reorder': 0.0,
+    'stall-every': 0.0,
+    'stall-ms': 500.0,
+    'seed': None,
+}
+
+# Should match server.py's FRAMERATE
+FRAME_SECS = 1/15
+
+class Direction:
+    def __init__(self, writer):
+        self.writer = writer
+        self.queue = asyncio.Queue()
+        # TCP keeps things in order, so nothing can be delivered before the thing ahead of it
+        self.last_due = 0
+        self.stalled_until = 0
+        self.next_stall = self.pick_next_stall(time.monotonic())
+
+    def pick_next_stall(self, now):
+        if opts['stall-every'] <= 0:
+            return float('inf')
+        return now + random.expovariate(1/opts['stall-every'])
+
+    def add(self, data):
+        now = time.monotonic()
+        if now >= self.next_stall:
+            self.stalled_until = now + opts['stall-ms']/1000
+            self.next_stall = self.pick_next_stall(self.stalled_until)
+        due = now + (opts['delay'] + random.uniform(0, opts['jitter']))/1000
+        if random.random() < opts['reorder']:
+            due += FRAME_SECS
+        due = max(due, self.last_due, self.stalled_until)
+        self.last_due = due
+        self.queue.put_nowait((due, data))
+
+    async def run(self):
+        while True:
+            due, data = await self.queue.get()
+            if data is None:
+                break
+            wait = due - time.monotonic()
+            if wait > 0:
+                await asyncio.sleep(wait)
+            try:
+                self.writer.write(data)
+                await self.writer.drain()
+            except ConnectionError:
+                break
+        # Passing the hangup along means the other direction finishes up too
+        self.writer.close()
+
+    def close(self):
+        self.queue.put_nowait((0, None))
+
+async def pump(reader, direction):
+    try:
+        while True:
+            data = await reader.read(65536)
+            if not data:
+                break
+            direction.add(data)
+    except ConnectionError:
+        pass
+    direction.close()
+
+async def handle_client(client_reader, client_writer, server_port):
+    peer = client_writer.get_extra_info('peername')
+    try:
+        server_reader, server_writer = await asyncio.open_connection('localhost', server_port)
+    except OSError as e:
+        print(f"Couldn't reach server for {peer}: {e}")
+        client_writer.close()
+        return
+    print(f"Proxying {peer}")
+    up = Direction(server_writer)
+    down = Direction(client_writer)
+    await asyncio.gather(
+        pump(client_reader, up),
+        pump(server_reader, down),
+        up.run(),
+        down.run(),
+    )
+    print(f"Done with {peer}")
+
+async def main(listen_port, server_port):
+    server = await asyncio.start_server(
+        lambda r, w: handle_client(r, w, server_port),
+        port=listen_port,
+    )
+    print(f"netsim listening on {listen_port}, forwarding to {server_port}, {opts}")
+    await server.serve_forever()
+
+def parse_args(args):
+    if len(args) < 2:
+        return None
+    try:
+        ports = (int(args[0]), int(args[1]))
+        rest = args[2:]
+        while rest:
+            name = rest[0][2:]
+            if not rest[0].startswith('--') or name not in opts or len(rest) < 2:
+                return None
+            opts[name] = type(opts[name] if opts[name] is not None else 0)(float(rest[1]))
+            rest = rest[2:]
+    except ValueError:
+        return None
+    return ports
+
+if __name__ == "__main__":
+    ports = parse_args(sys.argv[1:])
+    if ports is None:
+        print(usage)
+        sys.exit(1)
+    if opts['seed'] is not None:
+        random.seed(opts['seed'])
+    try:
+        asyncio.run(main(*ports))
+    except KeyboardInterrupt:
+        pass
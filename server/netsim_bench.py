@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+# Runs a server, a netsim proxy in front of it, and a bunch of headless clients,
+# then reports how the clients coped. Run from anywhere; paths are relative to this file.
+# Extra args are passed through to netsim.py, e.g.:
+#   ./server/netsim_bench.py 4 60 --delay 40 --jitter 30 --stall-every 10
+
+import os
+import re
+import sys
+import time
+import subprocess
+
+SERVER_PORT = 15100
+PROXY_PORT = 15101
+
+usage = """Usage: num_clients seconds [netsim options]
+
+Clients are the real game binary (`./game --headless`), so build that first.
+See netsim.py for the options."""
+
+here = os.path.dirname(os.path.abspath(__file__))
+root = os.path.dirname(here)
+
+def main(args):
+    if len(args) < 2:
+        print(usage)
+        return 1
+    try:
+        num_clients = int(args[0])
+        seconds = float(args[1])
+    except ValueError:
+        print(usage)
+        return 1
+
+    logs = os.path.join(root, 'netsim_logs')
+    os.makedirs(logs, exist_ok=True)
+    def log(name):
+        return open(os.path.join(logs, name), 'w')
+
+    server = subprocess.Popen([os.path.join(here, 'server.py'), str(SERVER_PORT)], stdout=log('server.txt'), stderr=subprocess.STDOUT)
+    proxy = subprocess.Popen([os.path.join(here, 'netsim.py'), str(PROXY_PORT), str(SERVER_PORT)] + args[2:], stdout=log('netsim.txt'), stderr=subprocess.STDOUT)
+    time.sleep(1)
+    if proxy.poll() is not None:
+        print("netsim.py exited early, check its options (log in netsim_logs/)")
+        server.kill()
+        return 1
+
+    clients = []
+    for i in range(num_clients):
+        # Started in order so the first one is the loader, and staggered a bit like real players joining.
+        # Everyone gets the same play time, so the last to join is the last to leave.
+        c = subprocess.Popen(['./game', '--headless', str(seconds), 'localhost', str(PROXY_PORT)], cwd=root, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+        clients.append(c)
+        time.sleep(0.5)
+
+    results = []
+    for i, c in enumerate(clients):
+        out, _ = c.communicate()
+        with log(f'client{i}.txt') as f:
+            f.write(out)
+        m = re.search(r'^HEADLESS (.*)$', out, re.MULTILINE)
+        if m is None:
+            print(f"client {i} didn't report stats (exit code {c.returncode}), see netsim_logs/client{i}.txt")
+            continue
+        results.append(dict(kv.split('=') for kv in m.group(1).split()))
+
+    proxy.kill()
+    server.kill()
+
+    if not results:
+        return 1
+    cols = ['client', 'resim_per_sec', 'catchups', 'mia_sleeps', 'late_batches', 'lead_ms']
+    print(''.join(f'{c:>14}' for c in cols))
+    for r in results:
+        print(''.join(f'{r[c]:>14}' for c in cols))
+    def total(c):
+        return sum(float(r[c]) for r in results)
+    print(f"avg resim/sec {total('resim_per_sec')/len(results):.1f}, catchups {total('catchups'):.0f}, mia sleeps {total('mia_sleeps'):.0f}")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -17,6 +17,14 @@ MAX_AHEAD = 15
 
 # max number of clients at any given time
 MAX_CLIENTS = 32
+# Spectators don't take a player slot or send anything, they just get a copy of every frame
+MAX_SPECTATORS = 64
+# Spectators that can't keep up get dropped rather than buffered forever. Unit is bytes
+SPECTATOR_MAX_BACKLOG = 4 * (1024 * 1024)
+SPECTATOR_PORT_OFFSET = 1
+# When a spectator joins, we tack this command onto some player's message so that the game gets synced.
+# (A spectator can't ask for itself, since it doesn't have a slot to send from.)
+SPECTATOR_CMD = b'/spectator'
 # max number of new clients in a quick burst. We allow our clients to fill up immediately on server start.
 # Probably not any reason this should ever be different from MAX_CLIENTS.
 CLIENT_POOL = MAX_CLIENTS
@@ -46,6 +54,7 @@ usage = """Usage: [port] [starting_players]
 
 This program can be run without arguments (e.g. \"./server.py\") for default behavior.
 Alternatively, a port number can be provided as the single argument.
+Spectators connect on the port after that one.
 A second argument will be interpreted as the `starting_players`, but this is only useful for debugging."""
 
 clientpool = CLIENT_POOL
@@ -76,6 +85,8 @@ class Host:
         self.frame = 0
         self.clients = [] # [None] * starting_players
         self.clientpool = CLIENT_POOL
+        self.spectators = []
+        self.spectator_sync = False
 
 class ClientNetHandler(asyncio.Protocol):
     def __init__(self):
@@ -264,26 +275,63 @@ class ClientNetHandler(asyncio.Protocol):
             # this host object and making a new one when necessary.
             active_host = None
 
+class SpectatorNetHandler(asyncio.Protocol):
+    def __init__(self):
+        self.inited = False
+
+    def connection_made(self, transport):
+        self.transport = transport
+        self.host = active_host
+        if self.host is None or not check_clientpool():
+            # Without players there's no game to sync from
+            print("Rejecting spectator, nobody is playing (or clientpool is exhausted)")
+            self.transport.close()
+            self.host = None
+            return
+        if len(self.host.spectators) >= MAX_SPECTATORS:
+            print("Rejecting spectator because MAX_SPECTATORS reached")
+            self.transport.close()
+            self.host = None
+            return
+        self.host.spectators.append(self)
+        self.host.spectator_sync = True
+        print(f"Connected spectator from {transport.get_extra_info('peername')}")
+
+    def data_received(self, data):
+        # Spectators don't get a say
+        pass
+
+    def connection_lost(self, exc):
+        if self.host is not None and self in self.host.spectators:
+            self.host.spectators.remove(self)
+            print("Connection to spectator lost")
+
+def make_socket(port):
+    server_socket = socket.socket(socket.AF_INET6, socket.SOCK_STREAM)
+    server_socket.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    # This should be inherited by sockets created via 'accept'
+    server_socket.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    # Asyncio turns off mapped addresses, so we have to provide our own socket with mapped addresses enabled
+    server_socket.setsockopt(socket.IPPROTO_IPV6, socket.IPV6_V6ONLY, 0)
+    server_socket.bind(('', port))
+    return server_socket
+
 async def do_server(port):
     try:
-        # Open port
-        server_socket = socket.socket(socket.AF_INET6, socket.SOCK_STREAM)
-        server_socket.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
-        # This should be inherited by sockets created via 'accept'
-        server_socket.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
-        # Asyncio turns off mapped addresses, so we have to provide our own socket with mapped addresses enabled
-        server_socket.setsockopt(socket.IPPROTO_IPV6, socket.IPV6_V6ONLY, 0)
-        server_socket.bind(('', port))
-
+        # Open ports
         server = await asyncio.get_running_loop().create_server(
             ClientNetHandler,
-            sock=server_socket
+            sock=make_socket(port)
+        )
+        spectator_server = await asyncio.get_running_loop().create_server(
+            SpectatorNetHandler,
+            sock=make_socket(port + SPECTATOR_PORT_OFFSET)
         )
-        print("Server started on port " + str(port))
+        print(f"Server started on port {port} (spectators on {port + SPECTATOR_PORT_OFFSET})")
     except:
         print("Couldn't create network server!")
         raise
-    await server.serve_forever()
+    await asyncio.gather(server.serve_forever(), spectator_server.serve_forever())
 
 async def loop(host):
     print("Starting FRAMERATE thread")
@@ -308,6 +356,16 @@ async def loop(host):
         frame = host.frame
         host.frame = (frame+1)%FRAME_ID_MAX
 
+        if host.spectator_sync:
+            # Any message from anybody will do, it gets processed the same by everyone,
+            # as long as it has room for one more command (the first entry is the frame data, not a command).
+            # If nobody has anything this frame, try again next frame.
+            for c in clients:
+                if c is not None and c.complete_messages and len(c.complete_messages[-1]) < MAX_CMD_COUNT + 1:
+                    c.complete_messages[-1].append(len(SPECTATOR_CMD).to_bytes(4, 'big') + SPECTATOR_CMD)
+                    host.spectator_sync = False
+                    break
+
         anyConnectedClient = False
         msg = frame.to_bytes(4, 'big') + numClients.to_bytes(1, 'big')
         # Add everyone's data to the message, then clear their data
@@ -339,6 +397,8 @@ async def loop(host):
 
         if not anyConnectedClient:
             print("All clients disconnected, shutting down FRAMERATE thread until next connection")
+            for sp in host.spectators:
+                sp.transport.close()
             return
 
         for ix in range(numClients):
@@ -355,6 +415,19 @@ async def loop(host):
                 m = bytes([MAGIC_FIRST_BYTE, ix, numClients]) + frame.to_bytes(4, 'big') + msg
             cl.transport.write(m)
 
+        for sp in host.spectators.copy():
+            if sp.transport.get_write_buffer_size() > SPECTATOR_MAX_BACKLOG:
+                print("Closed spectator for falling too far behind")
+                sp.transport.close()
+                continue
+            if sp.inited:
+                m = msg
+            else:
+                # Same as for players, but a spectator's "slot" is 255
+                sp.inited = True
+                m = bytes([MAGIC_FIRST_BYTE, 255, numClients]) + frame.to_bytes(4, 'big') + msg
+            sp.transport.write(m)
+
 if __name__ == "__main__":
     args = sys.argv
     if len(args) > 3:
@@ -1,18 +1,19 @@
 #version 430 core
-layout(location=1, binding=0) uniform sampler2D u_tex;
+layout(location=1, binding=0) uniform sampler2DArray u_tex;
 layout(binding=1) uniform sampler2D u_mottle_tex;
 uniform vec4 u_tint;
-uniform float u_transparency;
 
 layout(location=0) in vec3 v_color;
 layout(location=1) in vec2 v_uv;
 layout(location=2) in vec2 v_mottle_1;
 layout(location=3) in vec2 v_mottle_2;
+layout(location=4) in float v_alpha;
+layout(location=5) flat in float v_layer;
 
 layout(location = 0) out vec4 out_color;
 
 void main() {
-	vec4 texColor = texture(u_tex, v_uv);
+	vec4 texColor = texture(u_tex, vec3(v_uv, v_layer));
 	if (texColor.a == 0) {
 		// Think I need this to prevent drawing to the Z-buffer
 		// Probably only used for billboards, seems silly
@@ -25,6 +26,6 @@ void main() {
 	brightness = brightness * u_tint.a;
 	vec4 tint_addition = vec4(u_tint.rgb, 0.0);
 
-	vec4 mult = vec4(brightness, brightness, brightness, u_transparency);
+	vec4 mult = vec4(brightness, brightness, brightness, v_alpha);
 	out_color = texColor*mult + tint_addition + vec4(v_color, 0.0);
 }
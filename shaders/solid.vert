@@ -7,6 +7,21 @@ layout(location=2) uniform float u_noise_scale;
 layout(location=3) uniform vec2 u_tex_offset;
 layout(location=4) uniform vec2 u_tex_scale;
 layout(location=5) uniform mat3 u_rot;
+uniform float u_transparency;
+// Which layer of the texture array to use
+uniform float u_layer;
+// 0 is regular drawing.
+// 1 is instanced cubes (see `flushCubes` in graphics.cpp), in which case the
+// per-instance attributes take the place of most of the above.
+// 2 is baked scenery (see `bakeFinish`), where vertexes are already
+// in chunk space and carry their own layer / noise scale.
+// 3 and 4 are instanced billboards and trails (see `flushParticles`),
+// which expand the "pane" mesh to face the camera.
+uniform int u_mode;
+uniform mat4 u_world_to_screen;
+uniform float u_interp;
+// Billboard size multipliers, same as the `ifov` values baked into the perspective matrix
+uniform vec2 u_billboard;
 // uniform vec3 u_tint;
 
 // I don't think I *need* explicit locations on these, since graphics.c asks GL what location they got anyway.
@@ -15,23 +30,109 @@ layout(location=5) uniform mat3 u_rot;
 layout(location=0) in vec3 a_pos;
 layout(location=1) in vec3 a_norm;
 layout(location=2) in vec2 a_tex_st;
+// Per-instance. Positions are already relative to the camera (old and new).
+layout(location=3) in vec3 a_i_pos1;
+layout(location=4) in vec3 a_i_pos2;
+layout(location=5) in vec4 a_i_rot1;
+layout(location=6) in vec4 a_i_rot2;
+layout(location=7) in vec2 a_i_scale_alpha;
+layout(location=8) in float a_i_layer;
+// Per-vertex, baked scenery only
+layout(location=9) in float a_b_layer;
+layout(location=10) in float a_b_noise_scale;
+// Per-instance, billboards and trails (which also use a_i_pos1/2 and a_i_layer).
+// Billboards: tex offset x/y, tex size, world size.
+// Trails: direction (unit length), half of the trail length.
+layout(location=11) in vec4 a_p_param;
+// Trails only, how far along it is in fading out (0-1)
+layout(location=12) in float a_p_age;
 
 layout(location=0) out vec3 v_color;
 layout(location=1) out vec2 v_uv;
 layout(location=2) out vec2 v_mottle_1;
 layout(location=3) out vec2 v_mottle_2;
+layout(location=4) out float v_alpha;
+layout(location=5) flat out float v_layer;
+
+// Same as `mat3FromQuat` in matrix.cpp
+mat3 quatToMat(vec4 q) {
+	return mat3(
+		1-2*q.z*q.z-2*q.w*q.w,   2*q.y*q.z+2*q.x*q.w,   2*q.y*q.w-2*q.x*q.z,
+		  2*q.y*q.z-2*q.x*q.w, 1-2*q.y*q.y-2*q.w*q.w,   2*q.z*q.w+2*q.x*q.y,
+		  2*q.y*q.w+2*q.x*q.z,   2*q.z*q.w-2*q.x*q.y, 1-2*q.y*q.y-2*q.z*q.z
+	);
+}
 
 void main()
 {
-	gl_Position = u_modelview * vec4(a_pos, 1.0);
-	v_uv = u_tex_offset + u_tex_scale*a_tex_st;
-	v_mottle_1 = u_noise_scale*v_uv;
-	v_mottle_2 = 1.618034*u_noise_scale*v_uv;
+	mat3 rot;
+	float noise_scale;
+	if (u_mode == 1) {
+		// Same interpolation `drawCube` does on the CPU (lerping the matrices, not the quats)
+		mat3 rot1 = quatToMat(a_i_rot1);
+		rot = rot1 + u_interp*(quatToMat(a_i_rot2) - rot1);
+		vec3 translate = mix(a_i_pos1, a_i_pos2, u_interp);
+		float scale = a_i_scale_alpha.x;
+		gl_Position = u_world_to_screen * vec4(scale*(rot*a_pos) + translate, 1.0);
+		noise_scale = scale/1000.0;
+		v_alpha = a_i_scale_alpha.y;
+		v_layer = a_i_layer;
+	} else if (u_mode == 2) {
+		// Normals were rotated during baking
+		rot = mat3(1.0);
+		gl_Position = u_modelview * vec4(a_pos, 1.0);
+		noise_scale = a_b_noise_scale;
+		v_alpha = u_transparency;
+		v_layer = a_b_layer;
+	} else if (u_mode == 3) {
+		// The pane's normals are all 0 anyway, so lighting doesn't matter
+		rot = mat3(1.0);
+		vec3 translate = mix(a_i_pos1, a_i_pos2, u_interp);
+		gl_Position = u_world_to_screen * vec4(translate, 1.0);
+		// Offset in screen space, so it always faces us
+		gl_Position.xy += a_p_param.w * u_billboard * a_pos.xz;
+		noise_scale = 1;
+		v_alpha = 1;
+		v_layer = a_i_layer;
+	} else if (u_mode == 4) {
+		rot = mat3(1.0);
+		vec3 forward = a_p_param.w * a_p_param.xyz;
+		vec3 translate = mix(a_i_pos1, a_i_pos2, u_interp) + forward;
+		// `sideways` depends on the angle we're looking at the trail from.
+		// Scale factor on the direction here relates to distance from trail.
+		vec3 sideways = cross(translate, 0.5*a_p_param.xyz);
+		float magnitude = length(sideways);
+		float trail_width = -10.0/(a_p_age+0.1)+110.0;
+		// If camera lines up too closely w/ trail,
+		// it will shrink to nothing,
+		// instead of spinning around dramatically as the camera makes its near approach
+		if (magnitude > trail_width) sideways *= trail_width/magnitude;
+		gl_Position = u_world_to_screen * vec4(translate + a_pos.x*sideways + a_pos.z*forward, 1.0);
+		noise_scale = 1;
+		v_alpha = 1.0-a_p_age;
+		v_layer = a_i_layer;
+	} else {
+		rot = u_rot;
+		gl_Position = u_modelview * vec4(a_pos, 1.0);
+		noise_scale = u_noise_scale;
+		v_alpha = u_transparency;
+		v_layer = u_layer;
+	}
+	if (u_mode == 3) {
+		v_uv = a_p_param.xy + a_p_param.z*a_tex_st;
+	} else if (u_mode == 4) {
+		// Trail texture only varies across its width
+		v_uv = vec2(a_tex_st.x, 0);
+	} else {
+		v_uv = u_tex_offset + u_tex_scale*a_tex_st;
+	}
+	v_mottle_1 = noise_scale*v_uv;
+	v_mottle_2 = 1.618034*noise_scale*v_uv;
 
 	// I want my faces to look a bit different based on angle.
 	// Normally I'd put them in shadow, but I already have this code here,
 	// and it's literally 00:02AM right now.
-	float lighting_dot = dot(vec3(0.44, 0, 0.9), u_rot*a_norm);
+	float lighting_dot = dot(vec3(0.44, 0, 0.9), rot*a_norm);
 	vec3 glare = lighting_dot * vec3(0.15,0.15,0.15);
 
 	// v_color = glare + (0.75 + 0.25*lighting_dot)*u_tint;
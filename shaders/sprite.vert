@@ -1,19 +1,29 @@
 #version 430
 
-uniform vec2 u_offset;
-uniform vec2 u_tex_offset;
-uniform vec2 u_size;
-uniform vec2 u_scale;
-uniform vec2 u_tex_scale;
+// Sprites are drawn in batches, one instance per quad (see `flush2d` in graphics.cpp).
+// All the old per-sprite uniforms are folded into these before upload.
 
 layout(location=0) in vec2 a_loc;
+// Per-instance. Screen position + size, already scaled to clip space.
+layout(location=1) in vec4 a_q_rect;
+// Per-instance. Tex coord position + size, already scaled to 0-1.
+layout(location=2) in vec4 a_q_uv;
+layout(location=3) in float a_q_layer;
+layout(location=4) in vec4 a_q_c_mult;
+layout(location=5) in vec4 a_q_c_add;
 
 layout(location=0) out vec2 v_uv;
+layout(location=1) flat out float v_layer;
+layout(location=2) flat out vec4 v_c_mult;
+layout(location=3) flat out vec4 v_c_add;
 
 void main()
 {
-	vec2 v = u_scale * (u_offset + u_size*a_loc);
+	vec2 v = a_q_rect.xy + a_q_rect.zw*a_loc;
 	gl_Position = vec4(v.xy, 0, 1.0);
 
-	v_uv = u_tex_scale * (u_tex_offset + u_size*a_loc);
+	v_uv = a_q_uv.xy + a_q_uv.zw*a_loc;
+	v_layer = a_q_layer;
+	v_c_mult = a_q_c_mult;
+	v_c_add = a_q_c_add;
 }
@@ -1,13 +1,14 @@
 #version 430 core
-layout(location=1) uniform sampler2D u_tex;
-uniform vec4 u_c_mult;
-uniform vec4 u_c_add;
+layout(location=1) uniform sampler2DArray u_tex;
 
 layout(location=0) in vec2 v_uv;
+layout(location=1) flat in float v_layer;
+layout(location=2) flat in vec4 v_c_mult;
+layout(location=3) flat in vec4 v_c_add;
 
 layout(location = 0) out vec4 out_color;
 
 void main()
 {
-	out_color = texture(u_tex, v_uv) * u_c_mult + u_c_add;
+	out_color = texture(u_tex, vec3(v_uv, v_layer)) * v_c_mult + v_c_add;
 }
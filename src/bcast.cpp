@@ -2,26 +2,60 @@
 #include "collision.h"
 #include "box.h"
 
-struct bcast_cand {
-	fraction time;
-	char isBox;
-	void *item;
+#include "bcast.h"
 
-	bool operator<(bcast_cand const &other) const {
-		return time.lt(other.time);
+void bcaster::init() {
+	cands.init();
+	heap.init();
+}
+
+void bcaster::destroy() {
+	cands.destroy();
+	heap.destroy();
+}
+
+char bcaster::less(int a, int b) const {
+	return cands[a].time.lt(cands[b].time);
+}
+
+// The heap logic here is the same as the min-heap stuff in `list.h`,
+// except that we only move indices around and compare what they point at.
+void bcaster::push(bcast_cand const &c) {
+	int ix = heap.num;
+	heap.add(cands.num);
+	cands.add(c);
+	while (ix > 0) {
+		int parent = (ix - 1) / 2;
+		if (!less(heap[ix], heap[parent])) break;
+		int tmp = heap[parent];
+		heap[parent] = heap[ix];
+		heap[ix] = tmp;
+		ix = parent;
 	}
-};
+}
 
-// TODO Is this too big to be shuffling around like this?
-//      Should I be going to more effort to just move around
-//      pointers instead of these big-honkin' structs?
-//      I probably don't mill through too many, so I could have
-//      an add-only list with the actual data, and rework the
-//      heap logic to assume it's always a pointer type.
-static list<bcast_cand> candidates;
-// Todo: Decide if `dir` and `origin` should be static state instead of passing them around everywhere
+int bcaster::pop() {
+	// caller is expected to ensure non-empty heap
+	int result = heap[0];
+	heap.num--;
+	heap[0] = heap[heap.num];
+	int ix = 0;
+	while (1) {
+		int left = 2 * ix + 1;
+		if (left >= heap.num) break;
+		int small = left;
+		int right = left + 1;
+		if (right < heap.num && less(heap[right], heap[left])) small = right;
+		if (!less(heap[small], heap[ix])) break;
+		int tmp = heap[ix];
+		heap[ix] = heap[small];
+		heap[small] = tmp;
+		ix = small;
+	}
+	return result;
+}
 
-static void addBoxCand(unitvec const dir, offset const origin, box *b) {
+void bcaster::addBoxCand(box *b) {
 	int32_t flip[3];
 	unitvec look;
 	range(i, 3) {
@@ -31,8 +65,8 @@ static void addBoxCand(unitvec const dir, offset const origin, box *b) {
 	bcast_cand c;
 	fraction &lower = c.time;
 	lower = {.numer=0, .denom=1};
-	fraction upper = {.numer=INT64_MAX/FIXP, .denom=1};
-	int32_t time = vb_now - b->start;
+	fraction upper = limit;
+	int32_t time = now - b->start;
 	range(i, 3) {
 		int64_t x = flip[i] * (b->pos[i] + b->vel[i]*time - origin[i]);
 		fraction f1 = {.numer = x - b->r, .denom = look[i]};
@@ -42,14 +76,28 @@ static void addBoxCand(unitvec const dir, offset const origin, box *b) {
 		if (f2.lt(upper)) upper = f2;
 		if (!lower.lt(upper)) return;
 	}
-	c.isBox = 1;
+	c.kind = BC_BOX;
 	c.item = b;
-	candidates.heap_push(c);
+	push(c);
 }
 
-static void addMoverCand(unitvec const dir, offset const origin, mover *m) {
+void bcaster::addMoverCand(mover *m, char shrink) {
+	if (m == ignore) return;
 	bcast_cand c;
-	c.time = {.numer = INT64_MAX/FIXP, .denom = 1};
+	// Starting at `limit` means `raycast` won't report anything we'd just throw out
+	c.time = limit;
+	if (m->type & T_CONSTEL) {
+		// Whole constel in one go. We only get a solid for
+		// the point that was hit if it turns out to be a winner.
+		constelInst *ci = constelInstFromMover(m);
+		if (raycast_constel(&c.time, &c.pt, ci, origin, dir)) {
+			c.kind = BC_CONSTEL;
+			c.item = ci;
+			push(c);
+			if (shrink) limit = c.time;
+		}
+		return;
+	}
 	// TODO Is this based off first position?
 	//      For now it's just shooting and selecting;
 	//      selecting doesn't really care, and shooting
@@ -60,40 +108,47 @@ static void addMoverCand(unitvec const dir, offset const origin, mover *m) {
 	//      just expired will be in the velbox tree or not?? Probably so,
 	//      but the tree has ticked, right? What's really going on???
 	if (raycast(&c.time, m, origin, dir)) {
-		c.isBox = 0;
+		c.kind = BC_MOVER;
 		c.item = m;
-		candidates.heap_push(c);
+		push(c);
+		if (shrink) limit = c.time;
 	}
 }
 
-// Caller is responsible for choosing a `b` that's small enough that we can
-// safely do `fraction` math on the distances involved.
-void bcast_start(box *b, unitvec const dir, offset const origin) {
-	candidates.num = 0;
+void bcaster::start(box *b, unitvec const _dir, offset const _origin, fraction const _limit, mover *_ignore) {
+	memcpy(dir, _dir, sizeof(unitvec));
+	memcpy(origin, _origin, sizeof(offset));
+	limit = _limit;
+	ignore = _ignore;
+	now = vb_now;
+	cands.num = 0;
+	heap.num = 0;
 	rangeconst(i, b->intersects.num) {
-		addBoxCand(dir, origin, b->intersects[i].b);
+		addBoxCand(b->intersects[i].b);
 	}
 }
 
-mover * bcast(fraction *out_time, unitvec const dir, offset const origin) {
-	while (candidates.num) {
-		bcast_cand c = candidates.heap_pop();
-		if (c.isBox) {
+mover* bcaster::run(fraction *out_time, char shrink) {
+	while (heap.num) {
+		// Copy it out, since `cands` may be reallocated by the adds below
+		bcast_cand c = cands[pop()];
+		if (c.kind == BC_BOX) {
+			// In `first` mode, a box's entry could be stale (we've since found
+			// something closer). It's not wrong to expand it, but it's a waste.
+			if (shrink && !c.time.lt(limit)) continue;
 			box *b = (box*)c.item;
 			if (b->data) {
-				addMoverCand(dir, origin, (mover*)b->data);
+				addMoverCand((mover*)b->data, shrink);
 			} else {
 				// Todo: Can this bulk-add be optimized at all? Probably not...
 				rangeconst(i, b->kids.num) {
-					addBoxCand(dir, origin, b->kids[i]);
+					addBoxCand(b->kids[i]);
 				}
 			}
+		} else if (c.kind == BC_CONSTEL) {
+			*out_time = c.time;
+			return &constelSolid((constelInst*)c.item, c.pt)->m;
 		} else {
-			// TODO: Save the heap_siftDown for the
-			//       beginning of the call, so the
-			//       last `bcast` doesn't have to pay
-			//       that price. Just gets a bit weird
-			//       since we init the heap strangely.
 			*out_time = c.time;
 			return (mover*)c.item;
 		}
@@ -101,10 +156,10 @@ mover * bcast(fraction *out_time, unitvec const dir, offset const origin) {
 	return NULL;
 }
 
-void bcast_init() {
-	candidates.init();
+mover* bcaster::next(fraction *out_time) {
+	return run(out_time, 0);
 }
 
-void bcast_destroy() {
-	candidates.destroy();
+mover* bcaster::first(fraction *out_time) {
+	return run(out_time, 1);
 }
@@ -1,8 +1,52 @@
-// Caller is responsible for choosing a `b` that's small enough that we can
-// safely do `fraction` math on the distances involved.
-// Also, assumes the vb leaf `mover`s have their oldPos / oldRot populated.
-extern void bcast_start(box *b, unitvec const dir, offset const origin);
-extern mover * bcast(fraction *out_time, unitvec const dir, offset const origin);
-
-extern void bcast_init();
-extern void bcast_destroy();
+#define BC_BOX 0
+#define BC_MOVER 1
+// `item` is a `constelInst`, `pt` says which point
+#define BC_CONSTEL 2
+
+struct bcast_cand {
+	fraction time;
+	char kind;
+	int pt;
+	void *item;
+};
+
+// A broadcast raycast in progress. Each caller owns one of these
+// (no shared file-static state), so different casts (shooting,
+// camera, editor selection) don't have to take turns.
+// Reusable; `start` resets everything but keeps the allocations.
+struct bcaster {
+	// Add-only storage for candidates; `heap` just shuffles indices into this.
+	list<bcast_cand> cands;
+	list<int> heap;
+
+	unitvec dir;
+	offset origin;
+	// Nothing at or beyond this time is added to the heap.
+	// In `first` mode, this shrinks to the best hit found so far.
+	fraction limit;
+	// This mover is never considered (typically whoever is casting the ray)
+	mover *ignore;
+	// Copied from `vb_now` at `start`
+	int32_t now;
+
+	void init();
+	void destroy();
+
+	// Caller is responsible for choosing a `b` that's small enough that we can
+	// safely do `fraction` math on the distances involved.
+	// Also, assumes the vb leaf `mover`s have their oldPos / oldRot populated.
+	void start(box *b, unitvec const dir, offset const origin, fraction const limit, mover *ignore);
+	// Returns hits in order of increasing time, or NULL once we're out of hits within `limit`.
+	mover* next(fraction *out_time);
+	// Like `next`, but only cares about the closest hit. Subtrees that can't beat
+	// the best hit seen so far are pruned, so this leaves the cursor unusable for more `next` calls.
+	mover* first(fraction *out_time);
+
+private:
+	void addBoxCand(box *b);
+	void addMoverCand(mover *m, char shrink);
+	void push(bcast_cand const &c);
+	int pop();
+	char less(int a, int b) const;
+	mover* run(fraction *out_time, char shrink);
+};
@@ -202,10 +202,7 @@ void buildCtx::addPt(constel *c, int32_t shape, int32_t tex, int64_t size) {
 
 void buildCtx::addPt(tskRailsInstructions *instr, int32_t time) {
 	finalizeTranslate();
-	tskRailsPt &pt = instr->pts.add();
-	memcpy(pt.pos, transf.pos, sizeof(offset));
-	memcpy(pt.rot, transf.rot, sizeof(iquat));
-	pt.time = time;
+	tskRails_addPt(instr, transf.pos, transf.rot, time);
 	// I don't think we have any validation on this at the moment,
 	// the task itself handles weird values OK I believe.
 }
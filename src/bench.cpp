@@ -0,0 +1,306 @@
+#ifndef _WIN32
+// Headless render benchmark. There's no window or network here; we make an offscreen
+// GL context with EGL (works on GPU-less machines with Mesa's llvmpipe), load a level,
+// then fly the camera along a path and time `draw()`.
+//
+// Usage: ./game --bench [level] [frames] [path file]
+//   level: tdm1 (default), playground, swarm, or peaks
+//   frames: default 600
+//   path file: one camera point per line, "x y z yaw pitch" (position in world units,
+//              angles in radians, same as the mouse-look ones). Loops if `frames` is longer.
+//              Without one we just circle the origin.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <glad/gl.h>
+// build.sh only defines this if it finds EGL, since normal builds don't need it
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+// Import GLFW after glad. We don't use it, but `game_callbacks.h` mentions its types.
+#include <GLFW/glfw3.h>
+
+#include "util.h"
+#include "list.h"
+#include "queue.h"
+#include "file.h"
+#include "config.h"
+#include "main.h"
+#include "gamestate.h"
+#include "game_callbacks.h"
+#include "graphics_callbacks.h"
+#include "main_graphics.h"
+#include "lv.h"
+#include "glcount.h"
+#include "graphics.h"
+
+#include "bench.h"
+
+#define BENCH_WIDTH 1000
+#define BENCH_HEIGHT 700
+
+struct camPoint {
+	int64_t pos[3];
+	double yaw, pitch;
+};
+
+#ifdef HAVE_EGL
+static EGLDisplay eglDpy = EGL_NO_DISPLAY;
+static EGLSurface eglSurf = EGL_NO_SURFACE;
+static EGLContext eglCtx = EGL_NO_CONTEXT;
+
+char bench_initEgl() {
+	// Surfaceless is what works without any display server, so try that first
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay) {
+		eglDpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	if (eglDpy == EGL_NO_DISPLAY) eglDpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (eglDpy == EGL_NO_DISPLAY) {
+		puts("Couldn't get an EGL display");
+		return 1;
+	}
+	EGLint major, minor;
+	if (!eglInitialize(eglDpy, &major, &minor)) {
+		printf("eglInitialize failed, error 0x%X\n", eglGetError());
+		return 1;
+	}
+	printf(QUIET_LINE("EGL %d.%d"), major, minor);
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		puts("EGL doesn't do desktop OpenGL here");
+		return 1;
+	}
+
+	// A pbuffer gives us a real default framebuffer, which graphics.cpp assumes exists
+	EGLint const configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint numConfigs;
+	if (!eglChooseConfig(eglDpy, configAttribs, &config, 1, &numConfigs) || !numConfigs) {
+		puts("No suitable EGL config");
+		return 1;
+	}
+	EGLint const surfAttribs[] = {
+		EGL_WIDTH, BENCH_WIDTH,
+		EGL_HEIGHT, BENCH_HEIGHT,
+		EGL_NONE
+	};
+	eglSurf = eglCreatePbufferSurface(eglDpy, config, surfAttribs);
+	if (eglSurf == EGL_NO_SURFACE) {
+		printf("eglCreatePbufferSurface failed, error 0x%X\n", eglGetError());
+		return 1;
+	}
+	EGLint const ctxAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	eglCtx = eglCreateContext(eglDpy, config, EGL_NO_CONTEXT, ctxAttribs);
+	if (eglCtx == EGL_NO_CONTEXT) {
+		printf("eglCreateContext failed, error 0x%X\n", eglGetError());
+		return 1;
+	}
+	if (!eglMakeCurrent(eglDpy, eglSurf, eglSurf, eglCtx)) {
+		printf("eglMakeCurrent failed, error 0x%X\n", eglGetError());
+		return 1;
+	}
+	int version = gladLoadGL((GLADloadfunc) eglGetProcAddress);
+	if (version == 0) {
+		puts("Failed to initialize OpenGL context");
+		return 1;
+	}
+	printf(QUIET_LINE("Loaded OpenGL %d.%d (%s)"), GLAD_VERSION_MAJOR(version), GLAD_VERSION_MINOR(version), glGetString(GL_RENDERER));
+	return 0;
+}
+
+void bench_destroyEgl() {
+	eglMakeCurrent(eglDpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(eglDpy, eglCtx);
+	eglDestroySurface(eglDpy, eglSurf);
+	eglTerminate(eglDpy);
+}
+#else
+char bench_initEgl() {
+	puts("This build doesn't have EGL (install its dev package and rebuild)");
+	return 1;
+}
+
+void bench_destroyEgl() {}
+#endif
+
+static char loadLevel(gamestate *gs, char const *name) {
+	void (*lv)(gamestate*);
+	if (!strcmp(name, "tdm1")) lv = lv_tdm1;
+	else if (!strcmp(name, "playground")) lv = lv_playground;
+	else if (!strcmp(name, "swarm")) lv = lv_swarm;
+	else if (!strcmp(name, "peaks")) lv = lv_peaks;
+	else {
+		printf("Unknown level '%s'\n", name);
+		return 1;
+	}
+	prepareGamestateForLoad(gs, 0);
+	lv(gs);
+	return 0;
+}
+
+static char readPath(list<camPoint> *path, char const *file) {
+	FILE *f = fopen(file, "r");
+	if (!f) {
+		printf("Couldn't open camera path '%s'\n", file);
+		return 1;
+	}
+	camPoint pt;
+	while (5 == fscanf(f, "%ld %ld %ld %lf %lf", pt.pos, pt.pos+1, pt.pos+2, &pt.yaw, &pt.pitch)) {
+		path->add(pt);
+	}
+	fclose(f);
+	if (!path->num) {
+		printf("No camera points in '%s'\n", file);
+		return 1;
+	}
+	return 0;
+}
+
+static void defaultPath(list<camPoint> *path) {
+	// One lap in 10 seconds (at 60 fps), looking roughly along the circle
+	int const steps = 600;
+	range(i, steps) {
+		double angle = 2*M_PI*i/steps;
+		camPoint &pt = path->add();
+		pt.pos[0] = 20000*cos(angle);
+		pt.pos[1] = 20000*sin(angle);
+		pt.pos[2] = 3000;
+		pt.yaw = angle;
+		pt.pitch = -0.2;
+	}
+}
+
+static long threadNanos() {
+	timespec t;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+	return t.tv_sec*1'000'000'000L + t.tv_nsec;
+}
+
+static long wallNanos() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+	return t.tv_sec*1'000'000'000L + t.tv_nsec;
+}
+
+int bench_main(int argc, char **argv) {
+	char const *levelName = argc > 0 ? argv[0] : "tdm1";
+	int frames = argc > 1 ? atoi(argv[1]) : 600;
+	if (frames < 2) {
+		puts("Need at least 2 frames");
+		return 1;
+	}
+
+	if (bench_initEgl()) return 1;
+	setDisplaySize(BENCH_WIDTH, BENCH_HEIGHT);
+
+	msgs_game = new list<ggc_msg>();
+	msgs_game->init();
+	msgs_gfx = new list<ggc_msg>();
+	msgs_gfx->init();
+	outboundTextQueue.init();
+	game_init();
+	file_init();
+	config_init();
+	gamestate *gs = game_init2();
+	myPlayer = 0;
+	setupPlayers(gs, 1);
+
+	list<camPoint> path;
+	path.init();
+	char failed = loadLevel(gs, levelName);
+	if (!failed) {
+		if (argc > 2) failed = readPath(&path, argv[2]);
+		else defaultPath(&path);
+	}
+	if (failed) {
+		// Not bothering with tidy cleanup on this path
+		return 1;
+	}
+
+	// Don't want decode/upload of textures landing in the timed frames
+	gfx_finishTextureLoads();
+	glcount_install();
+	glcount_timers(1);
+	renderThreadSwitchOn();
+	renderSnapshot *rs = mkRenderSnapshot();
+	player &p = gs->players[0];
+	long cpuTotal = 0, cpuMin = 0, cpuMax = 0, wallTotal = 0;
+	long firstCpu = 0;
+	range(i, frames) {
+		camPoint const &pt = path[i % path.num];
+		memcpy(p.m.oldPos, i ? p.m.pos : pt.pos, sizeof(offset));
+		memcpy(p.m.pos, pt.pos, sizeof(offset));
+		setLookAngles(pt.yaw, pt.pitch);
+		fillRenderSnapshot(rs, gs);
+		// No render thread to hand these to, so they go straight over
+		msgs_gfx->addAll(msgs_game);
+		msgs_game->num = 0;
+
+		long wall0 = wallNanos();
+		long cpu0 = threadNanos();
+		draw(rs, 1.0f, 0, 0);
+		long cpu = threadNanos() - cpu0;
+		// Make sure the GPU (or llvmpipe) actually did the work before the next frame
+		glFinish();
+		long wall = wallNanos() - wall0;
+		glcount_frame();
+
+		// The first frame bakes everything, so it's reported on its own
+		if (!i) {
+			firstCpu = cpu;
+			glcount_resetAverages();
+			continue;
+		}
+		cpuTotal += cpu;
+		wallTotal += wall;
+		if (i == 1 || cpu < cpuMin) cpuMin = cpu;
+		if (cpu > cpuMax) cpuMax = cpu;
+	}
+	renderThreadSwitchOff();
+
+	int n = frames - 1;
+	printf("level %s, %d frames at %dx%d\n", levelName, frames, BENCH_WIDTH, BENCH_HEIGHT);
+	printf("first frame cpu: %.3f ms\n", firstCpu/1e6);
+	printf("draw() cpu ms/frame: avg %.3f, min %.3f, max %.3f\n", cpuTotal/1e6/n, cpuMin/1e6, cpuMax/1e6);
+	printf("wall ms/frame (incl. glFinish): avg %.3f\n", wallTotal/1e6/n);
+	list<char> report;
+	report.init();
+	glcount_report(&report);
+	fwrite(report.items, 1, report.num, stdout);
+	report.destroy();
+
+	freeRenderSnapshot(rs);
+	path.destroy();
+	cleanup(gs);
+	free(gs);
+	config_destroy();
+	file_destroy();
+	outboundTextQueue.destroy();
+	game_destroy();
+	msgs_gfx->destroy();
+	delete msgs_gfx;
+	msgs_game->destroy();
+	delete msgs_game;
+	bench_destroyEgl();
+	return 0;
+}
+#endif
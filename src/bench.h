@@ -0,0 +1,9 @@
+#pragma once
+
+// `argc` / `argv` are whatever came after "--bench"
+extern int bench_main(int argc, char **argv);
+
+// Offscreen GL context with no window, so `game_init` has something to work with.
+// `--headless` uses these too.
+extern char bench_initEgl();
+extern void bench_destroyEgl();
@@ -314,23 +314,22 @@ foundSampleNorm:;
 // with a whole nasty nested network of solids.
 // Maybe a related problem, do we keep this network around? Or do we add things to it as we go???
 
-static char raycast_inner(fraction *best, mover const *m, offset const vWorld, imat const rot, unitvec const dir) {
+static void moverShape(mover const *m, int32_t *shape, int64_t *r) {
+	if (m->type & T_PLAYER) {
+		*shape = 0;
+		*r = PLAYER_SHAPE_RADIUS;
+	} else {
+		*shape = m->type;
+		*r = solidFromMover(m)->r;
+	}
+}
+
+static char raycast_inner(fraction *best, int32_t shape, int64_t r, offset const vWorld, imat const rot, unitvec const dir) {
 	offset vSolid;
 	imat_applySm(vSolid, rot, vWorld);
 	unitvec dirSolid;
 	imat_apply(dirSolid, rot, dir);
 
-	int shape;
-	int64_t r;
-	if (m->type & T_PLAYER) {
-		shape = 0;
-		r = PLAYER_SHAPE_RADIUS;
-	} else {
-		shape = m->type;
-		solid *s = solidFromMover(m);
-		r = s->r;
-	}
-
 	fraction lower = {.numer = 0, .denom = 1};
 	fraction upper = *best;
 	shapeSpec &sh = shapeSpecs[shape];
@@ -363,7 +362,10 @@ char raycast(fraction *best, mover *m, offset const origin, unitvec const dir) {
 	imat rot;
 	imatFromIquatInv(rot, m->oldRot);
 
-	return raycast_inner(best, m, vWorld, rot, dir);
+	int32_t shape;
+	int64_t r;
+	moverShape(m, &shape, &r);
+	return raycast_inner(best, shape, r, vWorld, rot, dir);
 }
 
 char raycast_interp(fraction *best, mover *m, offset const origin1, offset const origin2, unitvec const dir, float interpRatio) {
@@ -378,5 +380,146 @@ char raycast_interp(fraction *best, mover *m, offset const origin1, offset const
 	imatFromIquatInv(rot2, m->rot);
 	range(i, 9) rot1[i] += (int32_t)(interpRatio*(rot2[i] - rot1[i]));
 
-	return raycast_inner(best, m, vWorld, rot1, dir);
+	int32_t shape;
+	int64_t r;
+	moverShape(m, &shape, &r);
+	return raycast_inner(best, shape, r, vWorld, rot1, dir);
+}
+
+// Conservative check for whether a ray could possibly hit a sphere before `bestDist`.
+// Done in doubles; it's only a filter, and doubles won't overflow on big coordinates.
+static char rayNearSphere(offset const center, int64_t radius, offset const origin, unitvec const dir, double bestDist) {
+	double v[3];
+	range(i, 3) v[i] = center[i] - origin[i];
+	double along = (v[0]*dir[0] + v[1]*dir[1] + v[2]*dir[2]) / FIXP;
+	double bound = radius;
+	if (along < -bound || along - bound > bestDist) return 0;
+	double perp2 = 0;
+	range(i, 3) {
+		double x = v[i] - along*dir[i]/FIXP;
+		perp2 += x*x;
+	}
+	return perp2 <= bound*bound;
+}
+
+// `origin` and `dir` are in the constel's local space
+static void raycastConstelNode(constel const *c, int ix, fraction *best, int *ptOut, offset const origin, unitvec const dir) {
+	while (1) {
+		constelNode const &n = c->bvh[ix];
+		double bestDist = (double)best->numer*FIXP/best->denom;
+		if (!rayNearSphere(n.o, n.r, origin, dir, bestDist)) return;
+		if (n.right < 0) {
+			int pt = -1 - n.right;
+			constelPt const &cp = c->points[pt];
+			offset v;
+			range(i, 3) v[i] = cp.o[i] - origin[i];
+			// Relative to the constel, so no need to account for the instance's rotation
+			imat rot;
+			imatFromIquatInv(rot, cp.rot);
+			if (raycast_inner(best, cp.type, cp.r, v, rot, dir)) *ptOut = pt;
+			return;
+		}
+		raycastConstelNode(c, ix+1, best, ptOut, origin, dir);
+		ix = n.right;
+	}
+}
+
+// `inv` is the inverse of the constel instance's rotation, `pos` is its position
+static char raycastConstel(fraction *best, int *ptOut, constel const *c, offset const pos, imat const inv, offset const origin, unitvec const dir) {
+	if (!c->bvh.num) return 0;
+	offset v, localOrigin;
+	range(i, 3) v[i] = origin[i] - pos[i];
+	imat_applySm(localOrigin, inv, v);
+	unitvec localDir;
+	imat_apply(localDir, inv, dir);
+
+	int pt = -1;
+	raycastConstelNode(c, 0, best, &pt, localOrigin, localDir);
+	if (pt == -1) return 0;
+	*ptOut = pt;
+	return 1;
+}
+
+char raycast_constel(fraction *best, int *pt, constelInst const *ci, offset const origin, unitvec const dir) {
+	imat inv;
+	imatFromIquatInv(inv, ci->m.oldRot);
+	return raycastConstel(best, pt, ci->c, ci->m.oldPos, inv, origin, dir);
+}
+
+void rayBatch::init() {
+	targets.init();
+	interpRatio = 0;
+}
+
+void rayBatch::destroy() {
+	targets.destroy();
+}
+
+void rayBatch::clear(float _interpRatio) {
+	targets.num = 0;
+	interpRatio = _interpRatio;
+}
+
+void rayBatch::add(mover *m) {
+	rayTarget &t = targets.add();
+	t.m = m;
+	range(i, 3) t.pos[i] = m->oldPos[i] + (int64_t)(interpRatio*(m->pos[i] - m->oldPos[i]));
+	if (m->type & T_CONSTEL) {
+		// We check against the whole constel at once (using its bvh)
+		t.shape = RT_CONSTEL;
+		t.r = constelInstFromMover(m)->c->r;
+		t.bound = t.r;
+	} else {
+		moverShape(m, &t.shape, &t.r);
+		t.bound = t.r*shapeDiagonalMultipliers[t.shape];
+	}
+	// Pad out a bit so rounding never rejects something `raycast_inner` would hit
+	t.bound += 2;
+	t.hasRot = 0;
+}
+
+void rayBatch::addAll(list<mover*> const *movers) {
+	targets.setMaxUp(targets.num + movers->num);
+	rangeconst(i, movers->num) add((*movers)[i]);
+}
+
+char rayBatch::cast(fraction *best, int numRays, offset const *origins1, offset const *origins2, unitvec const dir, mover const *skip, char skipPlayers) {
+	offset origins[RAYBATCH_MAX_RAYS];
+#ifndef NODEBUG
+	if (numRays > RAYBATCH_MAX_RAYS) {
+		printf("rayBatch::cast: %d rays requested, only %d supported\n", numRays, RAYBATCH_MAX_RAYS);
+		numRays = RAYBATCH_MAX_RAYS;
+	}
+#endif
+	range(r, numRays) {
+		range(i, 3) {
+			origins[r][i] = origins1[r][i] + (int64_t)(interpRatio*(origins2[r][i] - origins1[r][i]));
+		}
+	}
+
+	char ret = 0;
+	range(ix, targets.num) {
+		rayTarget &t = targets[ix];
+		if (t.m == skip || (skipPlayers && (t.m->type & T_PLAYER))) continue;
+		range(r, numRays) {
+			double bestDist = (double)best->numer*FIXP/best->denom;
+			if (!rayNearSphere(t.pos, t.bound, origins[r], dir, bestDist)) continue;
+			if (!t.hasRot) {
+				imat rot2;
+				imatFromIquatInv(t.rot, t.m->oldRot);
+				imatFromIquatInv(rot2, t.m->rot);
+				range(i, 9) t.rot[i] += (int32_t)(interpRatio*(rot2[i] - t.rot[i]));
+				t.hasRot = 1;
+			}
+			if (t.shape == RT_CONSTEL) {
+				int pt;
+				ret |= raycastConstel(best, &pt, constelInstFromMover(t.m)->c, t.pos, t.rot, origins[r], dir);
+				continue;
+			}
+			offset vWorld;
+			range(i, 3) vWorld[i] = t.pos[i] - origins[r][i];
+			ret |= raycast_inner(best, t.shape, t.r, vWorld, t.rot, dir);
+		}
+	}
+	return ret;
 }
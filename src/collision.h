@@ -1,4 +1,47 @@
-
 extern int64_t collide_check(offset const oldPos, offset dest, int32_t radius, solid *s, unitvec forceDir_out, offset contactVel_out);
 extern char raycast(fraction *best, mover *m, offset const origin, unitvec const dir);
 extern char raycast_interp(fraction *best, mover *m, offset const origin1, offset const origin2, unitvec const dir, float interpRatio);
+
+// Like `raycast`, but against every point of `ci` (using the constel's bvh).
+// If there's a hit, `pt` is set to the index of the point.
+extern char raycast_constel(fraction *best, int *pt, constelInst const *ci, offset const origin, unitvec const dir);
+
+// Special `rayTarget::shape` value for a whole `constelInst`
+#define RT_CONSTEL -1
+
+// A mover with its position interpolated for a particular frame.
+// The (interpolated) rotation matrix is only worked out if some ray
+// actually gets close enough to need it, and then it's kept around.
+struct rayTarget {
+	mover *m;
+	offset pos;
+	int32_t shape;
+	// For RT_CONSTEL, this is the constel's radius
+	int64_t r;
+	// Bounding sphere, for cheap rejects
+	int64_t bound;
+	char hasRot;
+	imat rot;
+};
+
+#define RAYBATCH_MAX_RAYS 4
+
+// Lets the render thread test several rays against the same set of movers
+// without redoing the per-mover conversion / interpolation for each ray.
+// Fill it once per frame, then `cast` as many times as needed.
+struct rayBatch {
+	list<rayTarget> targets;
+	float interpRatio;
+
+	void init();
+	void destroy();
+
+	void clear(float interpRatio);
+	void add(mover *m);
+	void addAll(list<mover*> const *movers);
+
+	// Casts `numRays` (at most RAYBATCH_MAX_RAYS) parallel rays, each interpolated between `origins1[i]` and `origins2[i]`.
+	// `best` works the same as with `raycast` (it's both the limit and the output).
+	// Targets that are players are skipped if `skipPlayers` is set, or if they are `skip`.
+	char cast(fraction *best, int numRays, offset const *origins1, offset const *origins2, unitvec const dir, mover const *skip, char skipPlayers);
+};
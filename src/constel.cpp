@@ -1,3 +1,5 @@
+#include <math.h>
+
 #include "util.h"
 
 #include "gamestate.h"
@@ -18,6 +20,7 @@ void constel::decr() {
 
 	// Destroy constel
 	points.destroy();
+	bvh.destroy();
 	free(this);
 }
 
@@ -41,11 +44,125 @@ void constel::estimateRadius() {
 	}
 }
 
+// Scratch state for `buildBvh`. Only the game thread builds these.
+static list<int> bvhOrder;
+static int bvhSortAxis;
+static constel const *bvhSortConstel;
+
+static char bvhSortLe(int const &a, int const &b) {
+	list<constelPt> const &pts = bvhSortConstel->points;
+	return pts[a].o[bvhSortAxis] <= pts[b].o[bvhSortAxis];
+}
+
+// Smallest(ish) sphere containing both children. Done in doubles,
+// then rounded outwards so rounding can't leave anything uncovered.
+static void mergeSpheres(constelNode *out, constelNode const *a, constelNode const *b) {
+	double d[3];
+	range(i, 3) d[i] = b->o[i] - a->o[i];
+	double dist = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+	// One might already contain the other
+	if (dist + b->r <= a->r) {
+		memcpy(out->o, a->o, sizeof(offset));
+		out->r = a->r;
+		return;
+	}
+	if (dist + a->r <= b->r) {
+		memcpy(out->o, b->o, sizeof(offset));
+		out->r = b->r;
+		return;
+	}
+	double r = (dist + a->r + b->r) / 2;
+	double shift = (r - a->r) / dist;
+	range(i, 3) out->o[i] = a->o[i] + (int64_t)(d[i]*shift);
+	out->r = (int64_t)r + 2;
+}
+
+// Builds the subtree for `bvhOrder[lo..hi)`, returns the index of its root node
+static int buildNode(constel *c, int lo, int hi) {
+	int ix = c->bvh.num;
+	c->bvh.add();
+	if (hi - lo == 1) {
+		int pt = bvhOrder[lo];
+		constelPt const &cp = c->points[pt];
+		constelNode &n = c->bvh[ix];
+		memcpy(n.o, cp.o, sizeof(offset));
+		n.r = cp.r*shapeDiagonalMultipliers[cp.type] + 1;
+		n.right = -1 - pt;
+		return ix;
+	}
+
+	// Split along whichever axis the points are most spread out on
+	int64_t mins[3], maxs[3];
+	range(i, 3) mins[i] = maxs[i] = c->points[bvhOrder[lo]].o[i];
+	for (int j = lo+1; j < hi; j++) {
+		int64_t const *o = c->points[bvhOrder[j]].o;
+		range(i, 3) {
+			if (o[i] < mins[i]) mins[i] = o[i];
+			if (o[i] > maxs[i]) maxs[i] = o[i];
+		}
+	}
+	bvhSortAxis = 0;
+	range(i, 3) {
+		if (maxs[i] - mins[i] > maxs[bvhSortAxis] - mins[bvhSortAxis]) bvhSortAxis = i;
+	}
+	// `list::qsort` only does whole lists, so we sort a scratch copy of the range
+	list<int> sub = {.items = bvhOrder.items + lo, .num = hi - lo, .max = hi - lo};
+	sub.qsort(bvhSortLe);
+
+	int mid = (lo + hi) / 2;
+	buildNode(c, lo, mid);
+	int right = buildNode(c, mid, hi);
+	// `c->bvh` may have been reallocated, so no references until now
+	c->bvh[ix].right = right;
+	mergeSpheres(&c->bvh[ix], &c->bvh[ix+1], &c->bvh[right]);
+	return ix;
+}
+
+void constel::buildBvh() {
+	bvh.num = 0;
+	if (!points.num) return;
+	bvh.setMaxUp(2*points.num - 1);
+
+	bvhOrder.num = 0;
+	rangeconst(i, points.num) bvhOrder.add(i);
+	bvhSortConstel = this;
+	buildNode(this, 0, points.num);
+}
+
+static char nearNode(constelNode const &n, offset const p, double r) {
+	double d2 = 0;
+	range(i, 3) {
+		double x = n.o[i] - p[i];
+		d2 += x*x;
+	}
+	r += n.r;
+	return d2 <= r*r;
+}
+
+static void queryNode(constel const *c, int ix, offset const p1, offset const p2, double r, list<int> *results) {
+	while (1) {
+		constelNode const &n = c->bvh[ix];
+		if (!nearNode(n, p1, r) && !nearNode(n, p2, r)) return;
+		if (n.right < 0) {
+			results->add(-1 - n.right);
+			return;
+		}
+		queryNode(c, ix+1, p1, p2, r, results);
+		ix = n.right;
+	}
+}
+
+void constel::query(offset const p1, offset const p2, int64_t queryR, list<int> *results) const {
+	if (!bvh.num) return;
+	queryNode(this, 0, p1, p2, queryR, results);
+}
+
 constel* mkConstel() {
 	constel* ret = (constel*)malloc(sizeof(constel));
 
 	ret->refCount = 1;
 	ret->points.init();
+	ret->bvh.init();
 	ret->r = -1;
 	ret->serizIx = -1;
 
@@ -106,6 +223,7 @@ void constelSerizFinalize() {
 
 		trans64(&c->r);
 		transConstelPts(c);
+		if (seriz_reading) c->buildBvh();
 
 		// Clear out for next time.
 		// Could put this in a separate
@@ -126,12 +244,15 @@ void validate(constelPt *pt) {
 
 void constel_init() {
 	dummyConstel.points = {.items=NULL, .num=0, .max=0};
+	dummyConstel.bvh = {.items=NULL, .num=0, .max=0};
 	dummyConstel.r = 1'000;
 	dummyConstel.refCount = 1;
 
 	serizPtrs.init();
+	bvhOrder.init();
 }
 
 void constel_destroy() {
+	bvhOrder.destroy();
 	serizPtrs.destroy();
 }
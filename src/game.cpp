@@ -30,11 +30,14 @@
 #include "http.h"
 #include "lv.h"
 #include "mypoll.h"
+#include "net2.h"
+#include "inputcodec.h"
 #include "player.h"
 #include "sound.h" // needs game_graphics
-#include "bcast.h"
 #include "task.h"
 #include "config.h"
+#include "glcount.h"
+#include "file.h"
 
 #include "collision.h" // For raycasting
 
@@ -69,8 +72,13 @@ static double domeYaw = 0, domePitch = 0;
 // so I think this compiles about the same as a normal float?
 // Todo: Look into std::atomic<float>::is_always_lock_free, maybe warn at compile time if false.
 static std::atomic<float> aimAtCamTan(0.0f);
-static list<mover*> crosshairCandidates;
+// Everything the render thread raycasts against (camera, crosshair), prepared once per frame
+static rayBatch frameRays;
 static char renderStats = 0;
+// GPU timers are only on while the stats overlay is up; this is what the render thread last told `glcount`
+static char renderStatsTimers = 0;
+// Set by "/gldump", the render thread writes the GL call report on its next frame
+static std::atomic<char> glDumpRequested(0);
 
 static char editMenuState = -1;
 static int editMouseAmt = 0, editMouseShiftAmt = 0;
@@ -217,7 +225,7 @@ static void initConfigs() {
 //// Boring init stuff ////
 
 void game_init() {
-	crosshairCandidates.init();
+	frameRays.init();
 
 	initGraphics();
 	task_init();
@@ -225,7 +233,7 @@ void game_init() {
 	gamestate_init();
 	dl_init();
 	bctx_init();
-	bcast_init();
+	pl_init();
 	constel_init();
 
 	http_init();
@@ -262,7 +270,7 @@ void game_destroy() {
 	http_destroy();
 
 	constel_destroy();
-	bcast_destroy();
+	pl_destroy();
 	bctx_destroy();
 	dl_destroy();
 	gamestate_destroy();
@@ -270,7 +278,7 @@ void game_destroy() {
 	task_destroy();
 	gfx_destroy();
 
-	crosshairCandidates.destroy();
+	frameRays.destroy();
 }
 
 //// Game-Graphics-Communication stuff ////
@@ -355,12 +363,9 @@ void handleKey(int key, int action) {
 	}
 }
 
-static void handleLook(double dx, double dy) {
+static void applyDomeLook() {
 	quat o;
 
-	// dome look stuff
-	domeYaw   -= dx*look->sensitivity;
-	domePitch -= dy*look->sensitivity;
 	while (domeYaw >  M_PI) domeYaw -= 2*M_PI;
 	while (domeYaw < -M_PI) domeYaw += 2*M_PI;
 	if (domePitch > M_PI_2) domePitch = M_PI_2;
@@ -372,6 +377,17 @@ static void handleLook(double dx, double dy) {
 	quat pitchRot = {(float)cos(p), (float)sin(p), 0, 0};
 	quat_mult(o, pitchRot, yawRot);
 
+	// Common cleanup stuff
+	quat_norm(o);
+	memcpy(quatCamRotation, o, sizeof(quat));
+}
+
+static void handleLook(double dx, double dy) {
+	// dome look stuff
+	domeYaw   -= dx*look->sensitivity;
+	domePitch -= dy*look->sensitivity;
+	applyDomeLook();
+
 	/* Free-look stuff. I'm kinda proud of this, keeping it in!
 	float dist = sqrt(dx*dx + dy*dy);
 	float scale = -0.0008; // This negation was a later addition, need to factor it through
@@ -386,12 +402,17 @@ static void handleLook(double dx, double dy) {
 	// Positive Y -> mouse down -> rotate around +X
 
 	quat r = {cos(radians), (float)(s*dy/dist), 0, (float)(s*dx/dist)};
+	quat o;
 	quat_mult(o, r, quatCamRotation);
-	*/
-
-	// Common cleanup stuff
 	quat_norm(o);
 	memcpy(quatCamRotation, o, sizeof(quat));
+	*/
+}
+
+void setLookAngles(double yaw, double pitch) {
+	domeYaw = yaw;
+	domePitch = pitch;
+	applyDomeLook();
 }
 
 static void handleDrag(double x, double y) {
@@ -574,14 +595,14 @@ static void computeAimAtCamRotation(iquat output) {
 	}
 }
 
-// In theory I think this would let us have a dynamic size of input data per-frame.
-// In practice we don't use that, partly because anything that *might* winds up
-// being better implemented as a command, which ensures delivery (even if late,
-// or stacked up with commands from other frames).
-int getInputsSize() { return 7*sizeof(int32_t); }
-void serializeInputs(char * dest) {
-	// TODO I have all this nice stuff for serializing, and I'm going to ignore it
-	int32_t *p = (int32_t*) dest;
+// The size of input data can vary per-frame, which we use to pack the inputs down
+// (`inputcodec` usually gets the 7 int32s down to about a third of their raw size).
+// Anything bigger or less regular winds up being better implemented as a command,
+// which ensures delivery (even if late, or stacked up with commands from other frames).
+#define NUM_INPUTS 7
+int getInputsSize() { return INPUTCODEC_MAX_BYTES(NUM_INPUTS); }
+int serializeInputs(char * dest) {
+	int32_t p[NUM_INPUTS];
 
 	auto &inpState = sharedInputs.state;
 	float moveKeyboard[3] = {
@@ -625,6 +646,8 @@ void serializeInputs(char * dest) {
 		}
 		poll_game_flag.store(0, std::memory_order::release);
 	}
+
+	return inputcodec_encode(dest, p, NUM_INPUTS);
 }
 
 void playerInputs(player *p, char const *data, int size) {
@@ -636,7 +659,8 @@ void playerInputs(player *p, char const *data, int size) {
 	// - Malicious client
 	// - No data yet seen from client
 	// - Some other case I'm not sure about, maybe when client is late?
-	if (size < 7*(int)sizeof(int32_t)) {
+	int32_t ptr[NUM_INPUTS];
+	if (inputcodec_decode(ptr, NUM_INPUTS, data, size)) {
 		// Set inputs to zero
 		range(i, 3) p->inputs[i] = 0;
 		// Reset facing - a visual indicator I guess?
@@ -645,7 +669,6 @@ void playerInputs(player *p, char const *data, int size) {
 		return;
 	}
 
-	int32_t *ptr = (int32_t*)(data);
 	range(i, 3) p->inputs[i] = ptr[i];
 	range(i, 4) p->m.rot[i] = ptr[3+i];
 }
@@ -825,6 +848,10 @@ char handleLocalCommand(char * buf, list<char> * outData) {
 		else dl_hotbar("");
 		return 1;
 	}
+	if (isCmd(buf, "/gldump")) {
+		glDumpRequested.store(1, std::memory_order::relaxed);
+		return 1;
+	}
 	if (isCmd(buf, "/_cfgcam")) {
 		readLookConfigs();
 		return 1;
@@ -971,7 +998,7 @@ static void checkGgc() {
 	l.num = 0;
 }
 
-static void setSoundPosition(gamestate const *gs, player const *_p, int playerIx) {
+static void setSoundPosition(list<player> const &players, player const *_p, int playerIx) {
 	// Similar to the gfx math, but not quite.
 	// - This is based on player pos, not cam pos
 	// - Runs even if player in question is dead
@@ -979,7 +1006,7 @@ static void setSoundPosition(gamestate const *gs, player const *_p, int playerIx
 	// or something else, so doing it there would be a pain
 	// anyway!
 	player const &p = *_p;
-	player const &p2 = gs->players[playerIx];
+	player const &p2 = players[playerIx];
 	offset &dest = sound_playerPositions[playerIx].o;
 	range(i, 3) {
 		int64_t d1 = p2.m.oldPos[i] - p.m.oldPos[i];
@@ -1007,7 +1034,7 @@ static void drawPlayer(player *p, float alpha) {
 
 	if (p->skin) {
 		sprite = p->skin->tex;
-		// In this case `sprite` is a GL texture ID, not one of ours
+		// In this case `sprite` is a dyntex layer, not one of our usual textures
 		mode |= 32;
 	} else {
 		sprite = getTeamShirt(p->team);
@@ -1016,37 +1043,21 @@ static void drawPlayer(player *p, float alpha) {
 	drawCube(&p->m, PLAYER_SHAPE_RADIUS, sprite, mode, alpha);
 }
 
-static void castCam(gamestate *gs, player *self, offset p1, offset p2, fraction *best) {
+static void castCam(player *self, offset p1, offset p2, fraction *best) {
 	best->numer=PL_SHOOT_RANGE;
 	best->denom=FIXP;
 
 	unitvec dir;
 	range(i, 3) dir[i] = gfx_lookDir[i] * FIXP;
-	// Could use the stuff in vb_root, but the problem is not everything that's
+	// Could use only the stuff in vb_root, but the problem is not everything that's
 	// present while shooting is still there. For example, player boxes are
 	// cleaned up before the end of the step.
-	// For now we just try to check the same things that shooting does.
-	rangeconst(i, gs->players.num) {
-		player *p = &gs->players[i];
-		if (p == self) continue;
-		raycast_interp(best, &p->m, p1, p2, dir, gfx_interpRatio);
-	}
-
-	// Todo:
-	// This is horribly inefficient, but we're only doing it once per frame,
-	// and I just don't care enough. Can fix it later.
-	// I think `bcast.cpp` has better code for this, but I'd need to account
-	// for interpolation and also make sure the lists used are threadsafe.
-	crosshairCandidates.num = 0;
-	velbox_query_ts(gs->vb_root, &crosshairCandidates);
-
-	rangeconst(i, crosshairCandidates.num) {
-		mover *m = crosshairCandidates[i];
-		raycast_interp(best, m, p1, p2, dir, gfx_interpRatio);
-	}
+	// For now we just try to check the same things that shooting does,
+	// which is why `frameRays` has the players in it as well.
+	frameRays.cast(best, 1, (offset const*)p1, (offset const*)p2, dir, &self->m, 0);
 }
 
-static void drawCrosshair(gamestate *gs, player *self) {
+static void drawCrosshair(player *self) {
 	centeredGrid2d(256);
 	float y;
 
@@ -1066,14 +1077,14 @@ static void drawCrosshair(gamestate *gs, player *self) {
 			p1[i] += start * gfx_lookDir[i];
 			p2[i] += start * gfx_lookDir[i];
 		}
-		castCam(gs, self, p1, p2, &best);
+		castCam(self, p1, p2, &best);
 
 		float dist = (float)best.numer*FIXP/best.denom - (gfx_camDist*look->hovCos - start);
 		float vert = gfx_camDist * look->hovSin;
 		aimAtCamTan.store(vert/dist, std::memory_order::relaxed);
 	} else if (look->aimType == AIM_LOW) {
 		fraction best;
-		castCam(gs, self, self->m.oldPos, self->m.pos, &best);
+		castCam(self, self->m.oldPos, self->m.pos, &best);
 
 		float dist = gfx_camDist * look->hovCos + (float)best.numer*FIXP/best.denom;
 		float vert = gfx_camDist * look->hovSin;
@@ -1108,63 +1119,228 @@ static void drawCrosshair(gamestate *gs, player *self) {
 static void drawSolid(solid *s) {
 	// `s->tex & 31` is validated in gamestate.cpp
 	// Todo: This is weird and old, can just use (and validate) the whole int
-	drawCube(&s->m, s->r, s->tex & 31, s->m.type, 1.0f);
+	queueCube(&s->m, s->r, s->tex & 31, s->m.type, 1.0f);
+}
+
+//// Render snapshots ////
+
+struct snapTask {
+	taskDefn *defn;
+	void *data;
+};
+
+// Everything `draw` needs from a gamestate, copied out at the end of the game thread's
+// phantom step. This way the render thread never holds onto a gamestate, and the game
+// thread is free to keep stepping its phantom state in place.
+// The game thread owns all the refcounting (constels, skins, tasks), both when
+// filling one of these and when recycling it, so the render thread only ever reads.
+struct renderSnapshot {
+	int32_t clock;
+	// Whether our player is somewhere the camera could bump into things
+	char camCollides;
+	list<player> players;
+	// `gs->solids`, which never move. Only recopied when `sceneryStamp` changes.
+	list<solid> solids;
+	long sceneryStamp;
+	// Solids belonging to dynamics tasks
+	list<solid> bodies;
+	// Only `c` and `m` are filled in; no velbox, and no solids cache.
+	list<constelInst> constels;
+	list<trail> trails;
+	// Copies of just the tasks that have something to draw
+	list<snapTask> tasks;
+};
+
+renderSnapshot* mkRenderSnapshot() {
+	renderSnapshot *rs = (renderSnapshot*)malloc(sizeof(renderSnapshot));
+	rs->clock = 0;
+	rs->camCollides = 0;
+	rs->players.init();
+	rs->solids.init();
+	rs->sceneryStamp = 0;
+	rs->bodies.init();
+	rs->constels.init();
+	rs->trails.init();
+	rs->tasks.init();
+	return rs;
+}
+
+static void emptyRenderSnapshot(renderSnapshot *rs) {
+	rangeconst(i, rs->players.num) {
+		if (rs->players[i].skin) rs->players[i].skin->decr();
+	}
+	rs->players.num = 0;
+	// `solids` is left alone, see `fillRenderSnapshot`
+	rs->bodies.num = 0;
+	rangeconst(i, rs->constels.num) {
+		rs->constels[i].c->decr();
+	}
+	rs->constels.num = 0;
+	rs->trails.num = 0;
+	rangeconst(i, rs->tasks.num) {
+		snapTask &t = rs->tasks[i];
+		(*t.defn->destroy)(t.data);
+	}
+	rs->tasks.num = 0;
 }
 
-// The supplied gamestate is not being changed by anyone else (owned by the graphics thread),
-// but the game thread *can* be cloning it (`dup`) if there's no newer server data yet.
-// Graphics thread must bear this in mind if it wants to do any writes to data in `gs`.
-void draw(gamestate *gs, float interpRatio, long drawingNanos, long totalNanos) {
+void freeRenderSnapshot(renderSnapshot *rs) {
+	emptyRenderSnapshot(rs);
+	rs->players.destroy();
+	rs->solids.destroy();
+	rs->bodies.destroy();
+	rs->constels.destroy();
+	rs->trails.destroy();
+	rs->tasks.destroy();
+	free(rs);
+}
+
+// Game thread only, see `renderSnapshot`
+void fillRenderSnapshot(renderSnapshot *rs, gamestate *gs) {
+	emptyRenderSnapshot(rs);
+	rs->clock = gs->clock;
+	rs->camCollides = gs->players[myPlayer].prox != gs->vb_root;
+
+	rs->players.addAll(&gs->players);
+	rangeconst(i, rs->players.num) {
+		player &p = rs->players[i];
+		p.prox = NULL;
+		if (p.skin) p.skin->refs++;
+	}
+
+	if (rs->sceneryStamp != gs->sceneryStamp) {
+		rs->sceneryStamp = gs->sceneryStamp;
+		rs->solids.num = 0;
+		rs->solids.setMaxUp(gs->solids.num);
+		rangeconst(i, gs->solids.num) {
+			solid &s = rs->solids.add();
+			s = *gs->solids[i];
+			s.b = NULL;
+		}
+	}
+
+	rs->constels.setMaxUp(gs->constels.num);
+	rangeconst(i, gs->constels.num) {
+		constelInst const *src = gs->constels[i];
+		constelInst &ci = rs->constels.add();
+		memset(&ci, 0, sizeof(ci));
+		ci.c = src->c;
+		ci.c->incr();
+		ci.m = src->m;
+	}
+
+	rs->trails.addAll(&gs->trails);
+
+	for (taskInstance *t = gs->tasks.next; t != &gs->tasks; t = t->next) {
+		int id = t->defn->id;
+		if (id == TSK_DYNAMICS) {
+			// TODO I'm being lazy and goofy here
+			solid &s = rs->bodies.add();
+			s = *(solid*)t->data;
+			s.b = NULL;
+		} else if (id == TSK_BLAST || id == TSK_TDM) {
+			snapTask &st = rs->tasks.add();
+			st.defn = t->defn;
+			(*t->defn->copy)(&st.data, t->data);
+		}
+	}
+}
+
+// The supplied snapshot is only ever touched by the render thread while we have it,
+// but some things it points to (constels, skins, blast bits) are shared with the game thread,
+// so don't write through those.
+void draw(renderSnapshot *rs, float interpRatio, long drawingNanos, long totalNanos) {
 	updateTiming(&renderTotalTiming, totalNanos);
 	updateTiming(&renderTiming, drawingNanos);
 	gfx_interpRatio = interpRatio;
-	int32_t now = gs->clock;
+	int32_t now = rs->clock;
 
-	checkGgc();
-	player *p = &gs->players[myPlayer];
-	box *boxForCamCasting = p->prox == gs->vb_root ? NULL : p->prox;
-	setupFrame(p->m.oldPos, p->m.pos, boxForCamCasting, look);
+	if (renderStats != renderStatsTimers) {
+		renderStatsTimers = renderStats;
+		glcount_timers(renderStats);
+	}
+	if (glDumpRequested.exchange(0, std::memory_order::relaxed)) {
+		list<char> report;
+		report.init();
+		glcount_report(&report);
+		if (!writeFile("glstats.txt", &report)) printf("Wrote GL stats to data/glstats.txt\n");
+		report.destroy();
+		glcount_resetAverages();
+	}
 
-	// Draw normal solids
-	rangeconst(i, gs->solids.num) {
-		drawSolid(gs->solids[i]);
+	glcount_section(GLC_DYNTEX);
+	checkGgc();
+	glcount_section(GLC_WORLD);
+	player *p = &rs->players[myPlayer];
+	frameRays.clear(interpRatio);
+	range(i, rs->players.num) frameRays.add(&rs->players[i].m);
+	// Same stuff the velbox tree would have had in it
+	range(i, rs->solids.num) frameRays.add(&rs->solids[i].m);
+	range(i, rs->bodies.num) frameRays.add(&rs->bodies[i].m);
+	range(i, rs->constels.num) frameRays.add(&rs->constels[i].m);
+	rayBatch *camTargets = rs->camCollides ? &frameRays : NULL;
+	setupFrame(p->m.oldPos, p->m.pos, camTargets, look);
+
+	// Draw normal solids. They never move, so they're baked, and we only look at them when they change.
+	if (bakeBegin(rs->sceneryStamp)) {
+		rangeconst(i, rs->solids.num) {
+			solid *s = &rs->solids[i];
+			bakeCube(&s->m, s->r, s->tex & 31, s->m.type);
+		}
 	}
-	// Draw solids in constels
-	rangeconst(i, gs->constels.num) {
-		constelInst *ci = gs->constels[i];
-		// Currently all constels are always expanded, so this is pretty easy
-		rangeconst(j, ci->solids.num) {
-			drawSolid(&ci->solids[j]);
+	bakeFinish();
+	// Draw solids in constels.
+	// These aren't baked, since any of them might start moving (e.g. rails stopping and starting).
+	rangeconst(i, rs->constels.num) {
+		constelInst *ci = &rs->constels[i];
+		// We don't have its solids (they're just a cache anyway),
+		// so we work out where the points are ourselves.
+		constel const *c = ci->c;
+		imat rot1, rot2;
+		imatFromIquat(rot1, ci->m.oldRot);
+		imatFromIquat(rot2, ci->m.rot);
+		mover m;
+		rangeconst(j, c->points.num) {
+			constelPtMover(&m, ci, j, rot1, rot2);
+			constelPt const &pt = c->points[j];
+			queueCube(&m, pt.r, pt.tex & 31, pt.type, 1.0f);
 		}
 	}
 	// Todo Should maybe make a render fn part of the task
 	//      so I can just call them here instead of having
 	//      a dispatch table or whatever. But there's also
 	//      3D vs 2D rendering to consider, idk yet.
-	for (taskInstance *t = gs->tasks.next; t != &gs->tasks; t = t->next) {
-		if (t->defn->id == TSK_DYNAMICS) {
-			// TODO I'm being lazy and goofy here
-			drawSolid((solid*)t->data);
-		} else if (t->defn->id == TSK_BLAST) {
-			tskBlast_draw(t->data, now);
+	rangeconst(i, rs->bodies.num) {
+		drawSolid(&rs->bodies[i]);
+	}
+	// All the opaque cubes go out in one batch, before anything that blends
+	flushCubes();
+	rangeconst(i, rs->tasks.num) {
+		snapTask &t = rs->tasks[i];
+		if (t.defn->id == TSK_BLAST) {
+			tskBlast_draw(t.data, now);
 		}
 	}
 
-	sound_playerPositions.setMaxUp(gs->players.num);
-	sound_playerPositions.num = gs->players.num;
-	rangeconst(i, gs->players.num) {
-		setSoundPosition(gs, p, i);
+	sound_playerPositions.setMaxUp(rs->players.num);
+	sound_playerPositions.num = rs->players.num;
+	glcount_section(GLC_PLAYERS);
+	rangeconst(i, rs->players.num) {
+		setSoundPosition(rs->players, p, i);
 		if (i == myPlayer) continue;
-		player *p2 = &gs->players[i];
+		player *p2 = &rs->players[i];
 		drawPlayer(p2, 1.0f);
 	}
 	tint(0, 0, 0, 0); // Clear tint.
 
-	rangeconst(i, gs->trails.num) {
-		trail &tr = gs->trails[i];
-		drawTrail(tr.origin, tr.dir, tr.len, 1.0f - ((float)(tr.expiry-now)-interpRatio)/TRAIL_LIFETIME);
+	rangeconst(i, rs->trails.num) {
+		trail &tr = rs->trails[i];
+		queueTrail(tr.origin, tr.dir, tr.len, 1.0f - ((float)(tr.expiry-now)-interpRatio)/TRAIL_LIFETIME);
 	}
-	reset3dTexScale();
+	// Blast bits were queued earlier, by `tskBlast_draw`.
+	// This does its own `glcount_section`s.
+	flushParticles();
+	glcount_section(GLC_PLAYERS);
 
 
 	// This used to go to 0 right as the camera hits the player's edge,
@@ -1177,9 +1353,10 @@ void draw(gamestate *gs, float interpRatio, long drawingNanos, long totalNanos)
 	drawPlayer(p, alpha);
 
 
+	glcount_section(GLC_HUD);
 	setup2dDrawing();
 
-	drawCrosshair(gs, p);
+	drawCrosshair(p);
 
 	// Draw hearts for player health
 	if (p->alive) {
@@ -1192,9 +1369,10 @@ void draw(gamestate *gs, float interpRatio, long drawingNanos, long totalNanos)
 
 	setup2dTextDrawing();
 
-	for (taskInstance *t = gs->tasks.next; t != &gs->tasks; t = t->next) {
-		if (t->defn->id == TSK_TDM) {
-			taskTdm_draw(t->data, interpRatio);
+	rangeconst(i, rs->tasks.num) {
+		snapTask &t = rs->tasks[i];
+		if (t.defn->id == TSK_TDM) {
+			taskTdm_draw(t.data, interpRatio);
 			setup2dTextDrawing();
 		}
 	}
@@ -1286,7 +1464,81 @@ void draw(gamestate *gs, float interpRatio, long drawingNanos, long totalNanos)
 			100*renderTiming.maxNanos/renderDenom
 		);
 		drawText(msg, 1, displayAreaBounds[1]*2-8);
+		// Snapshots skipped (game thread outran us) / frames drawn from an old snapshot
+		snprintf(
+			msg, 20, "ovr%5d rep%5d",
+			renderFramesOverwritten.load(std::memory_order::relaxed),
+			renderFramesRepeated
+		);
+		drawText(msg, 1, displayAreaBounds[1]*2-15);
+		// Network frames per poll wakeup (avg, max), and how long we hold `netMutex` for them (avg, max)
+		{
+			long wakeups = net2_wakeups.load(std::memory_order::relaxed);
+			if (!wakeups) wakeups = 1;
+			snprintf(
+				msg, 20, "nf%5.2f%4ld",
+				(double)net2_frames.load(std::memory_order::relaxed) / wakeups,
+				net2_maxBatch.load(std::memory_order::relaxed)
+			);
+			drawText(msg, 1, displayAreaBounds[1]*2-29-7*GLC_NUM);
+			snprintf(
+				msg, 20, "lk%5.1f%7.1fus",
+				net2_lockNanos.load(std::memory_order::relaxed) / 1e3 / wakeups,
+				net2_maxLockNanos.load(std::memory_order::relaxed) / 1e3
+			);
+			drawText(msg, 1, displayAreaBounds[1]*2-36-7*GLC_NUM);
+		}
+		// Round trip and jitter; how far ahead our inputs go out (avg / target, ms), and frames re-simulated per step
+		snprintf(
+			msg, 20, "rtt%5.1f jit%5.1f",
+			net2_rttMicros.load(std::memory_order::relaxed) / 1e3,
+			net2_jitterMicros.load(std::memory_order::relaxed) / 1e3
+		);
+		drawText(msg, 1, displayAreaBounds[1]*2-43-7*GLC_NUM);
+		snprintf(
+			msg, 20, "ld%4.0f/%4.0f rb%4.1f",
+			leadAvgMicros.load(std::memory_order::relaxed) / 1e3,
+			leadTargetMicros.load(std::memory_order::relaxed) / 1e3,
+			rollbackCenti.load(std::memory_order::relaxed) / 100.0
+		);
+		drawText(msg, 1, displayAreaBounds[1]*2-50-7*GLC_NUM);
+		// How late the game thread wakes for ticks (us): median and 99th percentile (as bucket upper bounds), and worst
+		{
+			int counts[TICK_LATE_BUCKETS];
+			int total = 0;
+			range(i, TICK_LATE_BUCKETS) total += counts[i] = tickLateHist[i].load(std::memory_order::relaxed);
+			int p50 = 0, p99 = 0, seen = 0;
+			if (total) range(i, TICK_LATE_BUCKETS) {
+				seen += counts[i];
+				if (!p50 && 2*seen >= total) p50 = 1 << i;
+				if (!p99 && 100*seen >= 99*total) p99 = 1 << i;
+			}
+			snprintf(msg, 20, "wk%4d%5d%6dus", p50, p99, tickLateMaxMicros.load(std::memory_order::relaxed));
+			drawText(msg, 1, displayAreaBounds[1]*2-57-7*GLC_NUM);
+		}
+		// Last frame's GL calls by section: draws, state changes (of any kind), GPU ms
+		glCounts total;
+		glcount_total(&total, glcountsLast);
+		range(i, GLC_NUM+1) {
+			glCounts const &c = i < GLC_NUM ? glcountsLast[i] : total;
+			char const *name = i < GLC_NUM ? glcSectionNames[i] : "total";
+			int changes = c.binds + c.uniforms + c.state;
+			float gpu = 0;
+			if (i < GLC_NUM) {
+				gpu = glcountGpuMs[i];
+			} else {
+				range(j, GLC_NUM) gpu += glcountGpuMs[j];
+			}
+			if (glcountGpuMs[0] >= 0) {
+				snprintf(msg, 20, "%-4.4s%4d%5d%6.2f", name, c.draws, changes, gpu);
+			} else {
+				snprintf(msg, 20, "%-4.4s%4d%5d", name, c.draws, changes);
+			}
+			drawText(msg, 1, displayAreaBounds[1]*2-22-7*(GLC_NUM-i));
+		}
 	}
+	flush2d();
+	glcount_section(GLC_OTHER);
 
 	sound_frame(p->m.oldPos, p->m.pos, now, interpRatio, now - renderPhantomFrames);
 }
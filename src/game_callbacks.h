@@ -21,9 +21,12 @@ extern void mouse_button_callback(GLFWwindow *window, int button, int action, in
 extern void scroll_callback(GLFWwindow *window, double x, double y);
 extern void window_focus_callback(GLFWwindow *window, int focused);
 extern void copyInputs();
+// Most bytes `serializeInputs` might write. It returns how many it actually did.
 extern int getInputsSize();
-extern void serializeInputs(char * dest);
+extern int serializeInputs(char * dest);
 extern void playerInputs(player *p, char const *data, int size);
+// Sets the camera directly, rather than via mouse movement (used by the benchmark)
+extern void setLookAngles(double yaw, double pitch);
 
 //// Text command stuff ////
 
@@ -37,4 +40,10 @@ extern void prefsToCmds();
 
 extern void renderThreadSwitchOn();
 extern void renderThreadSwitchOff();
-extern void draw(gamestate *gs, float interpRatio, long drawingNanos, long totalNanos);
+// Render snapshots are what the game thread hands to the render thread.
+// `fillRenderSnapshot` and `freeRenderSnapshot` are game-thread only (or when no threads are running).
+struct renderSnapshot;
+extern renderSnapshot* mkRenderSnapshot();
+extern void fillRenderSnapshot(renderSnapshot *rs, gamestate *gs);
+extern void freeRenderSnapshot(renderSnapshot *rs);
+extern void draw(renderSnapshot *rs, float interpRatio, long drawingNanos, long totalNanos);
@@ -12,6 +12,8 @@
 
 static list<mover*> queryResults;
 static list<box*> tmpPlayerBoxes;
+// Scratch space for `expandQueryResults`
+static list<int> constelPts;
 
 int32_t gs_gravity = 30;
 
@@ -147,6 +149,14 @@ void cpSolid(solid *t, solid *s) {
 	t->b->data = &t->m;
 }
 
+// Stamps are never reused, even across different gamestates. That way a rolled-back phantom
+// (which is a `dup` of the root state) can't end up with the same stamp but different solids.
+static long lastSceneryStamp = 0;
+
+void sceneryChanged(gamestate *gs) {
+	gs->sceneryStamp = ++lastSceneryStamp;
+}
+
 solid* addSolid(gamestate *gs, box *b, int64_t x, int64_t y, int64_t z, int64_t r, int32_t shape, int32_t tex) {
 	solid *s = new solid();
 	gs->solids.add(s);
@@ -165,6 +175,7 @@ solid* addSolid(gamestate *gs, box *b, int64_t x, int64_t y, int64_t z, int64_t
 	solidValidate(s);
 
 	solidPutVb(s, b, 15);
+	sceneryChanged(gs);
 	return s;
 }
 
@@ -177,54 +188,135 @@ void rmSolid(gamestate *gs, solid *s) {
 	if (-1 != (ix = gs->selection.find(s))) gs->selection.stableRmAt(ix);
 	velbox_remove(s->b);
 	delete s;
+	sceneryChanged(gs);
 }
 
-static void constelMoveSolids(constelInst *_ci) {
-	constelInst &ci = *_ci;
-	constel &c = *ci.c;
-	imat rot1, rot2;
-	imatFromIquat(rot1, ci.m.oldRot);
-	imatFromIquat(rot2, ci.m.rot);
-	rangeconst(i, ci.solids.num) {
-		solid &s = ci.solids[i];
-		constelPt &cp = c.points[i];
-
-		offset o1, o2;
-		imat_applySm(o1, rot1, cp.o); // TODO fix dumbass "Sm" naming
-		imat_applySm(o2, rot2, cp.o);
-		range(j, 3) {
-			s.m.oldPos[j] = ci.m.oldPos[j] + o1[j];
-			s.m.pos[j] = ci.m.pos[j] + o2[j];
+// Works out where the i'th point of `ci` is (both old and new position / rotation).
+// `rot1` / `rot2` are `ci`'s old / new rotations, already converted via `imatFromIquat`.
+void constelPtMover(mover *out, constelInst const *ci, int i, imat const rot1, imat const rot2) {
+	constelPt const &cp = ci->c->points[i];
+
+	offset o1, o2;
+	imat_applySm(o1, rot1, cp.o); // TODO fix dumbass "Sm" naming
+	imat_applySm(o2, rot2, cp.o);
+	range(j, 3) {
+		out->oldPos[j] = ci->m.oldPos[j] + o1[j];
+		out->pos[j] = ci->m.pos[j] + o2[j];
+	}
+
+	iquat_mult(out->oldRot, cp.rot, ci->m.oldRot);
+	iquat_mult(out->rot   , cp.rot, ci->m.rot   );
+	out->type = cp.type;
+}
+
+static void constelPutVb(constelInst *ci, box *guess) {
+	box *tmp = velbox_alloc();
+	ci->prox = tmp;
+	memcpy(tmp->pos, ci->m.oldPos, sizeof(tmp->pos));
+	range(i, 3) tmp->vel[i] = ci->m.pos[i] - ci->m.oldPos[i];
+	tmp->r = ci->c->r;
+	tmp->end = tmp->start + ci->duration;
+	tmp->data = &ci->m;
+	velbox_insert(guess, tmp);
+}
+
+// Gets a solid for the i'th point of `ci`, positioned for the current tick.
+// Pointer is good until the next `constelUpdate` (i.e. for the rest of the tick).
+// This also counts as somebody being interested in `ci`, and resets the linger timer.
+solid* constelSolid(constelInst *ci, int i) {
+	ci->touched = vb_now;
+	constel *c = ci->c;
+	if (!ci->solids.num) {
+		ci->solids.setMaxUp(c->points.num);
+		ci->solids.num = c->points.num;
+		ci->solidsClock.setMaxUp(c->points.num);
+		ci->solidsClock.num = c->points.num;
+		rangeconst(j, c->points.num) {
+			constelPt &pt = c->points[j];
+			solid &s = ci->solids[j];
+			s.r = pt.r;
+			s.tex = pt.tex;
+			// Not actually in the velbox tree, but people use `b` as a query guess
+			s.b = ci->prox;
+			ci->solidsClock[j] = vb_now - 1;
 		}
+	}
 
-		iquat_mult(s.m.oldRot, cp.rot, ci.m.oldRot);
-		iquat_mult(s.m.rot   , cp.rot, ci.m.rot   );
+	solid *s = &ci->solids[i];
+	if (ci->solidsClock[i] != vb_now) {
+		ci->solidsClock[i] = vb_now;
+		imat rot1, rot2;
+		imatFromIquat(rot1, ci->m.oldRot);
+		imatFromIquat(rot2, ci->m.rot);
+		constelPtMover(&s->m, ci, i, rot1, rot2);
+		// `prox` may have been replaced since we last looked
+		s->b = ci->prox;
 	}
+	return s;
 }
 
 static void constelUpdate(gamestate *gs, constelInst *_ci) {
 	constelInst &ci = *_ci;
-	// For my sanity, probably better if constelInst
-	// always has either child solids or the aggregate mover
-	// recorded in vb_root at the end of the tick.
-	// Will make it simpler for e.g. camera position casting.
-
-	// We don't want to be re-allocating `ci.solids` while it contains stuff
-	// (as that would mess up the `mover*`s in `vb_tree`),
-	// so it's fair to assume it has either 0 items or the same number as `c.points`.
-
-	if (ci.solids.num) {
-		constelMoveSolids(&ci);
-
-		if (!vb_live(ci.solids[0].b)) {
-			rangeconst(i, ci.solids.num) {
-				box *old = ci.solids[i].b;
-				box *p = old->parent;
-				velbox_reclaimDead(old);
-				solidPutVb(&ci.solids[i], p, ci.duration);
-			}
+	// Nothing here depends on how many points we have,
+	// our solids are only positioned when somebody asks.
+
+	if (!vb_live(ci.prox)) {
+		box *old = ci.prox;
+		box *p = old->parent;
+		velbox_reclaimDead(old);
+		constelPutVb(&ci, p);
+	}
+
+	// We don't want to be re-allocating `ci.solids` while anyone has pointers into it,
+	// which is why we only ever drop the whole thing, and only at the start of the tick.
+	if (ci.solids.num && vb_now - ci.touched > CONSTEL_LINGER) {
+		ci.solids.num = 0;
+		ci.solidsClock.num = 0;
+	}
+}
+
+// Velbox queries may return the aggregate leaf of a `constelInst`, which isn't a solid.
+// This swaps those out of `results` for solids from the constel that might be within
+// the query's bounds (same args as the `velbox_query`).
+// The query is transformed into constel space (both at the start and end of the tick),
+// and we walk the constel's `bvh` there.
+// Should only be used in the game thread, since it can modify the gamestate.
+void expandQueryResults(list<mover*> *results, offset const pos, offset const vel, int64_t r) {
+	// Bounding sphere for the query: It's a cube that sweeps along `vel`
+	offset center;
+	range(i, 3) center[i] = pos[i] + vel[i]/2;
+	int64_t queryR = r*shapeDiagonalMultipliers[0] + mag(vel)/2 + 1;
+
+	int num = results->num;
+	int dest = 0;
+	range(i, num) {
+		mover *m = (*results)[i];
+		if (!(m->type & T_CONSTEL)) {
+			(*results)[dest++] = m;
+			continue;
 		}
+		constelInst *ci = constelInstFromMover(m);
+		offset p1, p2, tmp;
+		imat inv;
+		range(j, 3) tmp[j] = center[j] - ci->m.oldPos[j];
+		imatFromIquatInv(inv, ci->m.oldRot);
+		imat_applySm(p1, inv, tmp);
+		range(j, 3) tmp[j] = center[j] - ci->m.pos[j];
+		imatFromIquatInv(inv, ci->m.rot);
+		imat_applySm(p2, inv, tmp);
+
+		constelPts.num = 0;
+		ci->c->query(p1, p2, queryR, &constelPts);
+		// Results get appended after the originals, we'll shift them down after.
+		rangeconst(j, constelPts.num) {
+			results->add(&constelSolid(ci, constelPts[j])->m);
+		}
+	}
+	// Move anything we appended down into the gap left by the aggregate leafs
+	for (int i = num; i < results->num; i++) {
+		(*results)[dest++] = (*results)[i];
 	}
+	results->num = dest;
 }
 
 static void cpConstelInst(constelInst *b, constelInst *a) {
@@ -233,12 +325,14 @@ static void cpConstelInst(constelInst *b, constelInst *a) {
 
 	b->m = a->m;
 	b->duration = a->duration;
+	b->touched = a->touched;
 
-	b->solids.init(a->solids.num);
-	b->solids.num = a->solids.num;
-	rangeconst(i, a->solids.num) {
-		cpSolid(&b->solids[i], &a->solids[i]);
-	}
+	b->prox = (box*)(a->prox->clone.ptr);
+	b->prox->data = &b->m;
+
+	// Solids are just a cache, the new state can position its own if it needs them
+	b->solids.init();
+	b->solidsClock.init();
 
 	a->clone.ptr = b;
 }
@@ -250,47 +344,38 @@ constelInst* mkConstelInst(constel *c, int32_t duration) {
 	c->incr();
 
 	// Caller is expected to initialize most of ci->m, but we'll set the type here.
-	// It's always 0, we don't even serialize it.
-	ci->m.type = 0;
+	// It's always the same, we don't even serialize it.
+	ci->m.type = T_CONSTEL;
 
 	ci->duration = duration;
+	ci->prox = NULL;
+	ci->touched = 0;
 	ci->solids.init();
-	// For now, we don't really support constelInst's in implicit state,
-	// so it's expected you'll pass this to `addConstelInst` to create the solids.
+	ci->solidsClock.init();
+	// Pass this to `addConstelInst` to put it into the world.
 
 	return ci;
 }
 
 void addConstelInst(gamestate *gs, constelInst *ci) {
 	constel *c = ci->c;
+	// We need a radius for the aggregate leaf, not everyone bothers to set one.
+	if (c->r <= 0) c->estimateRadius();
+	// First time this constel is used, it won't have its bvh yet.
+	// This is before any gamestate with it is visible to the render thread.
+	if (!c->bvh.num && c->points.num) c->buildBvh();
 
-	ci->solids.setMaxUp(c->points.num);
-	ci->solids.num = c->points.num;
-	rangeconst(i, c->points.num) {
-		constelPt &pt = c->points[i];
-		solid &s = ci->solids[i];
-		s.r = pt.r;
-		s.tex = pt.tex;
-		s.m.type = pt.type;
-		// Other stuff is initialized in `constelMoveSolids`, below.
-	}
-	constelMoveSolids(ci);
-
-	box *p = gs->vb_root;
-	rangeconst(i, ci->solids.num) {
-		solidPutVb(&ci->solids[i], p, ci->duration);
-		p = ci->solids[i].b->parent;
-	}
+	ci->touched = vb_now;
+	constelPutVb(ci, gs->vb_root);
 
 	gs->constels.add(ci);
 }
 
 void deleteConstelInst(constelInst *ci) {
 	ci->c->decr();
-	rangeconst(i, ci->solids.num) {
-		velbox_remove(ci->solids[i].b);
-	}
+	if (ci->prox) velbox_remove(ci->prox);
 	ci->solids.destroy();
+	ci->solidsClock.destroy();
 	free(ci);
 }
 
@@ -332,6 +417,7 @@ static void playerUpdate(gamestate *gs, player *p) {
 
 	queryResults.num = 0;
 	p->prox = velbox_query(p->prox, p->m.pos, p->vel, 2000, &queryResults);
+	expandQueryResults(&queryResults, p->m.pos, p->vel, 2000);
 	unitvec forceDir;
 	offset contactVel;
 	queryResults.qsort(playerPhysLe);
@@ -498,6 +584,7 @@ gamestate* dup(gamestate *orig) {
 	ret->vb_root = velbox_dup(orig->vb_root);
 	ret->clock = orig->clock;
 	ret->seed = orig->seed;
+	ret->sceneryStamp = orig->sceneryStamp;
 
 	ret->solids.init(orig->solids.num);
 	ret->solids.num = orig->solids.num;
@@ -560,6 +647,7 @@ void init(gamestate *gs) {
 	gs->clock = 0;
 	vb_now = 0;
 	gs->seed = 1;
+	sceneryChanged(gs);
 }
 
 void cleanup(gamestate *gs) {
@@ -631,19 +719,32 @@ static void transConstelInst(constelInst *ci) {
 	range(i, 4) trans32(&ci->m.rot[i]);
 	range(i, 4) trans32(&ci->m.oldRot[i]);
 	trans32(&ci->duration);
+	if (seriz_version >= 1) {
+		transWeakRef(&ci->prox, &boxSerizPtrs);
+	} else {
+		// Older saves have no aggregate leaf, we'll make one once we know our radius.
+		ci->prox = NULL;
+	}
 	if (seriz_reading) {
+		ci->m.type = T_CONSTEL;
+		if (ci->prox) ci->prox->data = &ci->m;
+		ci->touched = 0;
 		ci->solids.init();
+		ci->solidsClock.init();
+	}
+	if (seriz_version < 1) {
+		// Older versions sent the solids, and had them in the velbox tree.
+		// They're defined by the constel + the mover, so now we just position them on demand.
+		// Read them in so we can take their leafs out of the velbox tree, then throw them out.
+		list<solid> old;
+		old.init();
+		transItemCount(&old);
+		rangeconst(i, old.num) {
+			transSolid(&old[i]);
+			if (old[i].b) velbox_remove(old[i].b);
+		}
+		old.destroy();
 	}
-	// I'm a little groggy, and not sure about this one.
-	// The thing is, we don't have to transfer the solids.
-	// They're defined by the constel + the mover.
-	// So I could always just re-create them during deserialization.
-	// Only downside is we'd have to do the velbox placement over again,
-	// but that's probably well worth it. Maybe this is a smaller Todo.
-	transItemCount(&ci->solids);
-	rangeconst(i, ci->solids.num) transSolid(&ci->solids[i]);
-	// We have no way to serialize a reference to a constelInst's solid right now,
-	// which is related to not setting clone.idx here (wouldn't be helpful).
 }
 
 static void transAllConstelInsts(gamestate *gs) {
@@ -662,15 +763,12 @@ static void transAllConstelInsts(gamestate *gs) {
 	constelSerizFinalize();
 
 	if (seriz_reading) {
-		// Validation that `constelInst`s have the same # of pts as their constels
-		range(i, gs->constels.num) {
+		rangeconst(i, gs->constels.num) {
 			constelInst *ci = gs->constels[i];
-			if (ci->solids.num && ci->solids.num != ci->c->points.num) {
-				if (seriz_error()) puts("Encountered a constelInst with the wrong # of pts");
-				deleteConstelInst(ci);
-				gs->constels.stableRmAt(i);
-				i--;
-			}
+			if (ci->prox) continue;
+			// Can't do this until after `constelSerizFinalize`, since we need `c->r`
+			if (ci->c->r <= 0) ci->c->estimateRadius();
+			constelPutVb(ci, gs->vb_root);
 		}
 	}
 }
@@ -797,6 +895,7 @@ static void trans(gamestate *gs) {
 	transTasks(gs);
 	trans32(&gs->clock);
 	trans32(&gs->seed);
+	if (seriz_reading) sceneryChanged(gs);
 }
 
 void serialize(gamestate *gs, list<char> *data) {
@@ -842,9 +941,11 @@ void dyntex_holder::decr() {
 void gamestate_init() {
 	queryResults.init();
 	tmpPlayerBoxes.init();
+	constelPts.init();
 }
 
 void gamestate_destroy() {
+	constelPts.destroy();
 	tmpPlayerBoxes.destroy();
 	queryResults.destroy();
 }
@@ -17,6 +17,8 @@ struct mover; // "box" and "gamestate" reference each other's types
 
 #define NUM_SHAPES 3
 #define T_PLAYER 32
+// The aggregate velbox leaf for an implicit `constelInst`, see `expandQueryResults`
+#define T_CONSTEL 64
 
 extern int32_t gs_gravity;
 extern double const shapeDiagonalMultipliers[NUM_SHAPES];
@@ -69,8 +71,12 @@ struct solid {
 
 // Constellations.
 // A set of solids, fixed relative to each other, that may appear multiple times (like a blueprint).
-// Eventually the idea is that each instance won't always be "explicit" in the world,
-// and can be "implicit" if nothing's colliding with it.
+// Each instance is just one velbox leaf for the whole thing. Queries that hit that leaf
+// are transformed into constel space and walk the constel's `bvh` to find specific points.
+// Points that turn up get a `solid` (positioned for the current tick) so the usual
+// collision code can work with them. Those are thrown out again once the
+// instance has been left alone for CONSTEL_LINGER ticks.
+#define CONSTEL_LINGER 30
 
 struct constelPt {
 	offset o;
@@ -80,9 +86,21 @@ struct constelPt {
 	int32_t tex;
 };
 
+// Node in a constel's bounding hierarchy, everything in constel-local space.
+// Nodes are bounding spheres; the left child of an interior node immediately follows it.
+struct constelNode {
+	offset o;
+	int64_t r;
+	// For interior nodes, the index of the right child.
+	// For leaves, `-1 - (index into points)`.
+	int32_t right;
+};
+
 // `constel`s are COW (copy-on-write), to reduce gamestate copy overhead.
 struct constel {
 	list<constelPt> points;
+	// Derived from `points`, see `buildBvh`. Not serialized.
+	list<constelNode> bvh;
 	int64_t r;
 	int refCount;
 	int serizIx;
@@ -93,14 +111,28 @@ struct constel {
 	// Still, quick-and-easy if you don't have a custom `r`
 	// to populate.
 	void estimateRadius();
+	// Must be called once `points` is done changing, before anyone queries it.
+	// `constel`s are shared between threads, so this shouldn't happen lazily.
+	void buildBvh();
+	// Adds the index of any point that might be within `queryR` of `p1` or `p2` (both local space)
+	void query(offset const p1, offset const p2, int64_t queryR, list<int> *results) const;
 };
 
+#define constelInstFromMover(x) ((constelInst*)((char*)(x) - offsetof(constelInst, m)))
 struct constelInst {
 	constel *c;
-	mover m;
-	// box *prox; // Will need this once it's ever implicit.
+	mover m; // `m.type` is always T_CONSTEL
+	// Aggregate velbox leaf (radius `c->r`). Our solids never go in the velbox tree.
+	box *prox;
 	int32_t duration;
+	// Last time somebody queried inside our bounds
+	int32_t touched;
+	// Either empty, or one per `c->points`. Only the ones that have been
+	// asked for (via `constelSolid`) this tick are positioned correctly;
+	// `solidsClock` says when each was last positioned.
+	// None of this is part of the "real" gamestate, it's just a cache.
 	list<solid> solids;
+	list<int32_t> solidsClock;
 	clone_t clone;
 };
 
@@ -122,6 +154,9 @@ struct gamestate {
 	box *vb_root;
 	int32_t clock;
 	uint32_t seed;
+	// Changes whenever `solids` does (see `sceneryChanged`), so the render thread knows when to rebake.
+	// Two states with the same stamp have the same solids. Not serialized; it's only meaningful in this process.
+	long sceneryStamp;
 };
 
 extern void resetPlayer(gamestate *gs, int i);
@@ -137,10 +172,15 @@ extern void solidPutVb(solid *s, box *guess, int duration);
 extern void cpSolid(solid *t, solid *s);
 extern solid* addSolid(gamestate *gs, box *b, int64_t x, int64_t y, int64_t z, int64_t r, int32_t shape, int32_t tex);
 extern void rmSolid(gamestate *gs, solid *s);
+// Anything that adds, removes, or edits `gs->solids` needs to call this (`addSolid` / `rmSolid` already do)
+extern void sceneryChanged(gamestate *gs);
 
 extern constelInst* mkConstelInst(constel *c, int32_t duration);
 extern void addConstelInst(gamestate *gs, constelInst *ci);
 extern void deleteConstelInst(constelInst *ci);
+extern solid* constelSolid(constelInst *ci, int i);
+extern void constelPtMover(mover *out, constelInst const *ci, int i, imat const rot1, imat const rot2);
+extern void expandQueryResults(list<mover*> *results, offset const pos, offset const vel, int64_t r);
 
 extern void addTask(gamestate *gs, int taskId, void *data);
 
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <glad/gl.h>
+
+#include "util.h"
+#include "list.h"
+
+#include "glcount.h"
+
+char const * const glcSectionNames[GLC_NUM] = {"other", "dyntex", "world", "blasts", "players", "trails", "hud"};
+
+glCounts glcounts[GLC_NUM];
+glCounts glcountsLast[GLC_NUM];
+float glcountGpuMs[GLC_NUM];
+static int curSection = GLC_OTHER;
+static char installed = 0;
+
+// Running totals for `glcount_report`
+static glCounts avgCounts[GLC_NUM];
+static int avgFrames;
+static double avgGpuMs[GLC_NUM];
+static int avgGpuFrames;
+
+// Timer queries are read back a few frames later so we never wait on the GPU.
+// Each frame gets a slot, and each stretch of a section within the frame gets a query.
+#define TIMER_SLOTS 3
+#define MAX_SPANS 32
+static struct {
+	GLuint queries[MAX_SPANS];
+	u8 sections[MAX_SPANS];
+	int num;
+} timerSlots[TIMER_SLOTS];
+static int timerSlot = 0;
+static char timersOn = 0, timersReady = 0, spanOpen = 0;
+
+#define WRAP(kind, name, PFN, params, args) \
+	static PFN real_##name; \
+	static void GLAD_API_PTR count_##name params { \
+		glcounts[curSection].kind++; \
+		real_##name args; \
+	}
+// END WRAP
+
+WRAP(draws, glDrawArrays, PFNGLDRAWARRAYSPROC, (GLenum a, GLint b, GLsizei c), (a, b, c))
+WRAP(draws, glDrawArraysInstanced, PFNGLDRAWARRAYSINSTANCEDPROC, (GLenum a, GLint b, GLsizei c, GLsizei d), (a, b, c, d))
+WRAP(draws, glDrawArraysInstancedBaseInstance, PFNGLDRAWARRAYSINSTANCEDBASEINSTANCEPROC, (GLenum a, GLint b, GLsizei c, GLsizei d, GLuint e), (a, b, c, d, e))
+WRAP(draws, glDrawElements, PFNGLDRAWELEMENTSPROC, (GLenum a, GLsizei b, GLenum c, void const *d), (a, b, c, d))
+
+WRAP(binds, glUseProgram, PFNGLUSEPROGRAMPROC, (GLuint a), (a))
+WRAP(binds, glBindVertexArray, PFNGLBINDVERTEXARRAYPROC, (GLuint a), (a))
+WRAP(binds, glBindBuffer, PFNGLBINDBUFFERPROC, (GLenum a, GLuint b), (a, b))
+WRAP(binds, glBindVertexBuffer, PFNGLBINDVERTEXBUFFERPROC, (GLuint a, GLuint b, GLintptr c, GLsizei d), (a, b, c, d))
+WRAP(binds, glBindTexture, PFNGLBINDTEXTUREPROC, (GLenum a, GLuint b), (a, b))
+WRAP(binds, glActiveTexture, PFNGLACTIVETEXTUREPROC, (GLenum a), (a))
+WRAP(binds, glBindFramebuffer, PFNGLBINDFRAMEBUFFERPROC, (GLenum a, GLuint b), (a, b))
+
+WRAP(uniforms, glUniform1i, PFNGLUNIFORM1IPROC, (GLint a, GLint b), (a, b))
+WRAP(uniforms, glUniform1f, PFNGLUNIFORM1FPROC, (GLint a, GLfloat b), (a, b))
+WRAP(uniforms, glUniform2f, PFNGLUNIFORM2FPROC, (GLint a, GLfloat b, GLfloat c), (a, b, c))
+WRAP(uniforms, glUniform4f, PFNGLUNIFORM4FPROC, (GLint a, GLfloat b, GLfloat c, GLfloat d, GLfloat e), (a, b, c, d, e))
+WRAP(uniforms, glUniform3fv, PFNGLUNIFORM3FVPROC, (GLint a, GLsizei b, GLfloat const *c), (a, b, c))
+WRAP(uniforms, glUniformMatrix3fv, PFNGLUNIFORMMATRIX3FVPROC, (GLint a, GLsizei b, GLboolean c, GLfloat const *d), (a, b, c, d))
+WRAP(uniforms, glUniformMatrix4fv, PFNGLUNIFORMMATRIX4FVPROC, (GLint a, GLsizei b, GLboolean c, GLfloat const *d), (a, b, c, d))
+
+WRAP(state, glEnable, PFNGLENABLEPROC, (GLenum a), (a))
+WRAP(state, glDisable, PFNGLDISABLEPROC, (GLenum a), (a))
+WRAP(state, glDepthMask, PFNGLDEPTHMASKPROC, (GLboolean a), (a))
+WRAP(state, glViewport, PFNGLVIEWPORTPROC, (GLint a, GLint b, GLsizei c, GLsizei d), (a, b, c, d))
+WRAP(state, glBlendFunc, PFNGLBLENDFUNCPROC, (GLenum a, GLenum b), (a, b))
+WRAP(state, glDrawBuffer, PFNGLDRAWBUFFERPROC, (GLenum a), (a))
+WRAP(state, glFramebufferTexture2D, PFNGLFRAMEBUFFERTEXTURE2DPROC, (GLenum a, GLenum b, GLenum c, GLuint d, GLint e), (a, b, c, d, e))
+
+WRAP(uploads, glBufferData, PFNGLBUFFERDATAPROC, (GLenum a, GLsizeiptr b, void const *c, GLenum d), (a, b, c, d))
+WRAP(uploads, glBufferSubData, PFNGLBUFFERSUBDATAPROC, (GLenum a, GLintptr b, GLsizeiptr c, void const *d), (a, b, c, d))
+WRAP(uploads, glTexSubImage3D, PFNGLTEXSUBIMAGE3DPROC, (GLenum a, GLint b, GLint c, GLint d, GLint e, GLsizei f, GLsizei g, GLsizei h, GLenum i, GLenum j, void const *k), (a, b, c, d, e, f, g, h, i, j, k))
+WRAP(uploads, glCopyTexSubImage3D, PFNGLCOPYTEXSUBIMAGE3DPROC, (GLenum a, GLint b, GLint c, GLint d, GLint e, GLint f, GLint g, GLsizei h, GLsizei i), (a, b, c, d, e, f, g, h, i))
+WRAP(uploads, glGenerateMipmap, PFNGLGENERATEMIPMAPPROC, (GLenum a), (a))
+
+#define HOOK(name) \
+	real_##name = glad_##name; \
+	glad_##name = count_##name;
+// END HOOK
+
+void glcount_install() {
+	if (installed) return;
+	installed = 1;
+	memset(glcounts, 0, sizeof(glcounts));
+	memset(glcountsLast, 0, sizeof(glcountsLast));
+	range(i, GLC_NUM) glcountGpuMs[i] = -1;
+	glcount_resetAverages();
+
+	HOOK(glDrawArrays);
+	HOOK(glDrawArraysInstanced);
+	HOOK(glDrawArraysInstancedBaseInstance);
+	HOOK(glDrawElements);
+
+	HOOK(glUseProgram);
+	HOOK(glBindVertexArray);
+	HOOK(glBindBuffer);
+	HOOK(glBindVertexBuffer);
+	HOOK(glBindTexture);
+	HOOK(glActiveTexture);
+	HOOK(glBindFramebuffer);
+
+	HOOK(glUniform1i);
+	HOOK(glUniform1f);
+	HOOK(glUniform2f);
+	HOOK(glUniform4f);
+	HOOK(glUniform3fv);
+	HOOK(glUniformMatrix3fv);
+	HOOK(glUniformMatrix4fv);
+
+	HOOK(glEnable);
+	HOOK(glDisable);
+	HOOK(glDepthMask);
+	HOOK(glViewport);
+	HOOK(glBlendFunc);
+	HOOK(glDrawBuffer);
+	HOOK(glFramebufferTexture2D);
+
+	HOOK(glBufferData);
+	HOOK(glBufferSubData);
+	HOOK(glTexSubImage3D);
+	HOOK(glCopyTexSubImage3D);
+	HOOK(glGenerateMipmap);
+}
+
+void glcount_timers(char enable) {
+	if (enable == timersOn) return;
+	if (enable && !timersReady) {
+		GLint bits = 0;
+		glGetQueryiv(GL_TIME_ELAPSED, GL_QUERY_COUNTER_BITS, &bits);
+		if (!bits) {
+			puts("GL_TIME_ELAPSED has no counter bits here, no GPU timing");
+			return;
+		}
+		range(i, TIMER_SLOTS) glGenQueries(MAX_SPANS, timerSlots[i].queries);
+		timersReady = 1;
+	}
+	timersOn = enable;
+	if (!enable) {
+		if (spanOpen) glEndQuery(GL_TIME_ELAPSED);
+		spanOpen = 0;
+		range(i, TIMER_SLOTS) timerSlots[i].num = 0;
+		range(i, GLC_NUM) glcountGpuMs[i] = -1;
+	}
+}
+
+static void beginSpan(int section) {
+	auto &slot = timerSlots[timerSlot];
+	// Out of queries, the rest of the frame gets lumped in with this span
+	if (slot.num == MAX_SPANS) return;
+	if (spanOpen) glEndQuery(GL_TIME_ELAPSED);
+	glBeginQuery(GL_TIME_ELAPSED, slot.queries[slot.num]);
+	slot.sections[slot.num] = section;
+	slot.num++;
+	spanOpen = 1;
+}
+
+static void collectSlot() {
+	auto &slot = timerSlots[timerSlot];
+	if (!slot.num) return;
+	GLint available = 0;
+	// Queries finish in order, so the last one is enough to check
+	glGetQueryObjectiv(slot.queries[slot.num-1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available) {
+		range(i, GLC_NUM) glcountGpuMs[i] = 0;
+		range(i, slot.num) {
+			GLuint64 ns;
+			glGetQueryObjectui64v(slot.queries[i], GL_QUERY_RESULT, &ns);
+			glcountGpuMs[slot.sections[i]] += ns/1e6;
+		}
+		range(i, GLC_NUM) avgGpuMs[i] += glcountGpuMs[i];
+		avgGpuFrames++;
+	}
+	// If it wasn't ready, we just lose that frame's timing
+	slot.num = 0;
+}
+
+void glcount_section(int section) {
+	if (section == curSection) return;
+	curSection = section;
+	if (timersOn) beginSpan(section);
+}
+
+void glcount_frame() {
+	if (timersOn) {
+		if (spanOpen) glEndQuery(GL_TIME_ELAPSED);
+		spanOpen = 0;
+		timerSlot = (timerSlot+1) % TIMER_SLOTS;
+		collectSlot();
+	}
+
+	memcpy(glcountsLast, glcounts, sizeof(glcounts));
+	range(i, GLC_NUM) {
+		glCounts &a = avgCounts[i];
+		glCounts const &c = glcounts[i];
+		a.draws += c.draws;
+		a.binds += c.binds;
+		a.uniforms += c.uniforms;
+		a.state += c.state;
+		a.uploads += c.uploads;
+	}
+	avgFrames++;
+	memset(glcounts, 0, sizeof(glcounts));
+
+	curSection = GLC_OTHER;
+	if (timersOn) beginSpan(GLC_OTHER);
+}
+
+void glcount_total(glCounts *out, glCounts const *sections) {
+	memset(out, 0, sizeof(glCounts));
+	range(i, GLC_NUM) {
+		out->draws += sections[i].draws;
+		out->binds += sections[i].binds;
+		out->uniforms += sections[i].uniforms;
+		out->state += sections[i].state;
+		out->uploads += sections[i].uploads;
+	}
+}
+
+static void addText(list<char> *out, char const *text, int len) {
+	out->setMaxUp(out->num + len);
+	memcpy(out->items + out->num, text, len);
+	out->num += len;
+}
+
+static void reportLine(list<char> *out, char const *name, glCounts const &c, double gpuMs) {
+	char line[100];
+	double n = avgFrames ? avgFrames : 1;
+	int len = snprintf(
+		line, 100, "%-8s %8.1f %8.1f %8.1f %8.1f %8.1f",
+		name, c.draws/n, c.binds/n, c.uniforms/n, c.state/n, c.uploads/n
+	);
+	if (avgGpuFrames) len += snprintf(line+len, 100-len, " %8.3f\n", gpuMs/avgGpuFrames);
+	else len += snprintf(line+len, 100-len, "        -\n");
+	if (len > 99) len = 99;
+	addText(out, line, len);
+}
+
+void glcount_report(list<char> *out) {
+	char line[100];
+	int len = snprintf(line, 100, "%d frames, per-frame averages\n", avgFrames);
+	addText(out, line, len);
+	len = snprintf(line, 100, "%-8s %8s %8s %8s %8s %8s %8s\n", "section", "draws", "binds", "uniforms", "state", "uploads", "gpu_ms");
+	addText(out, line, len);
+	double gpuTotal = 0;
+	range(i, GLC_NUM) {
+		reportLine(out, glcSectionNames[i], avgCounts[i], avgGpuMs[i]);
+		gpuTotal += avgGpuMs[i];
+	}
+	glCounts total;
+	glcount_total(&total, avgCounts);
+	reportLine(out, "total", total, gpuTotal);
+}
+
+void glcount_resetAverages() {
+	memset(avgCounts, 0, sizeof(avgCounts));
+	avgFrames = 0;
+	range(i, GLC_NUM) avgGpuMs[i] = 0;
+	avgGpuFrames = 0;
+}
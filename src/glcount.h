@@ -0,0 +1,49 @@
+#pragma once
+
+// Counts GL calls made through glad, by swapping its function pointers for wrappers.
+// Only the calls we actually make per-frame are wrapped.
+// Counting isn't synchronized, so only count from one thread (the one with the GL context).
+
+// Which part of the frame we're in. Counts (and GPU time) are kept per section.
+enum {
+	GLC_OTHER,
+	GLC_DYNTEX,
+	GLC_WORLD,
+	GLC_BLASTS,
+	GLC_PLAYERS,
+	GLC_TRAILS,
+	GLC_HUD,
+	GLC_NUM
+};
+extern char const * const glcSectionNames[GLC_NUM];
+
+struct glCounts {
+	int draws;
+	// Programs, VAOs, buffers, textures, framebuffers
+	int binds;
+	int uniforms;
+	// Everything else that changes pipeline state (enable/disable, depth mask, viewport, ...)
+	int state;
+	// Buffer and texture data going up to the GPU
+	int uploads;
+};
+
+// Frame in progress, and the last complete frame
+extern glCounts glcounts[GLC_NUM];
+extern glCounts glcountsLast[GLC_NUM];
+// Most recent GPU time per section (from GL_TIME_ELAPSED queries, a couple frames behind),
+// or negative if we don't have any
+extern float glcountGpuMs[GLC_NUM];
+
+// Must be after `gladLoadGL`. Calling it more than once is fine.
+extern void glcount_install();
+// Turns GPU timer queries on/off. They're skipped if the driver has no timer bits.
+extern void glcount_timers(char enable);
+extern void glcount_section(int section);
+// Call once per frame, once it's done (after the swap / `glFinish`). Finishes off that frame's counts.
+extern void glcount_frame();
+// Sum of all sections
+extern void glcount_total(glCounts *out, glCounts const *sections);
+// Appends a text report of per-frame averages since the last `glcount_resetAverages`
+extern void glcount_report(list<char> *out);
+extern void glcount_resetAverages();
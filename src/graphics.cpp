@@ -11,19 +11,20 @@
 #include "util.h"
 #include "matrix.h"
 #include "main.h"
-#include "png.h"
+#include "texload.h"
 #include "gamestate.h"
 #include "game.h"
 #include "game_graphics.h"
 #include "main_graphics.h"
 #include "collision.h" // For raycasting, for camera position
 #include "mypoll.h"
+#include "glcount.h"
 
 #include "graphics.h"
 #include "graphics_callbacks.h"
 
 struct dyntex_texture {
-	GLuint tex;
+	int layer;
 	dyntex_description descr;
 	int holders;
 };
@@ -48,7 +49,26 @@ char const * const texSrcFiles[NUM_TEXS] = {
 	"guy.2.png",
 	"snakes.png",
 };
-GLuint textures[NUM_TEXS];
+// All our textures (besides the mottle tex) live in one texture array,
+// so switching textures between draws is just a uniform (or instance attribute).
+// Layer `i` is `texSrcFiles[i]` (layer 0 is unused), and the rest are reserved for dyntex skins.
+// Images smaller than TEX_RES get scaled up (nearest-neighbor) to fit.
+#define TEX_RES 128
+#define TEX_LEVELS 8 // 128 -> 1
+#define DYNTEX_LAYERS 16
+#define TEX_LAYERS (NUM_TEXS + DYNTEX_LAYERS)
+static GLuint texArray;
+static GLuint mottleTex;
+// Dyntexs get drawn here first, and then copied into their layer
+static GLuint dyntexScratch;
+// PNGs are decoded by `texload.cpp` worker threads, and uploaded through this PBO
+// (at most TEX_UPLOADS_PER_FRAME per frame). Until then the layer holds a placeholder.
+#define TEX_UPLOADS_PER_FRAME 2
+static GLuint texUploadPbo;
+// Bumped for every request, so a stale decode (file changed again meanwhile) gets tossed
+static int texRequestSeq[NUM_TEXS];
+// Single-layer views of `texArray`, made as needed, so we can redo one layer's mips at a time
+static GLuint texLayerViews[TEX_LAYERS];
 
 static void setupTextDrawingInner();
 static void populatePaneVertexData(list<GLfloat> *data);
@@ -75,9 +95,12 @@ static GLuint main_prog;
 static GLuint sprite_prog;
 // static GLuint flat_prog; // Will need this later, but don't feel like reworking shader rn
 
-static GLuint buffer_id, spr_buffer_id;
+static GLuint buffer_id, spr_buffer_id, inst_buffer_id, spr_inst_buffer_id, particle_buffer_id;
 static GLuint fb_id;
-static GLuint vaos[2];
+// [0] is regular 3D stuff, [1] is 2D sprites, [2] is the same as [0] plus instance data,
+// [3] is baked scenery (vertex format only, each chunk binds its own buffer),
+// [4] is the same as [0] plus billboard / trail instance data
+static GLuint vaos[5];
 
 static GLint u_main_modelview;
 static GLint u_main_rot;
@@ -86,14 +109,27 @@ static GLint u_main_tex_scale;
 static GLint u_main_tex_offset;
 static GLint u_main_tint;
 static GLint u_main_transparency;
-
-static GLint u_spr_size;
-static GLint u_spr_scale;
-static GLint u_spr_screen_offset;
-static GLint u_spr_tex_scale;
-static GLint u_spr_tex_offset;
-static GLint u_spr_color_mult;
-static GLint u_spr_color_add;
+static GLint u_main_mode;
+static GLint u_main_world_to_screen;
+static GLint u_main_interp;
+static GLint u_main_layer;
+static GLint u_main_billboard;
+
+// 2D stuff (sprites, text) is batched up and drawn by `flush2d`.
+// What used to be sprite uniforms is now just tracked here,
+// and gets folded into each quad as it's queued.
+struct spriteQuad {
+	GLfloat rect[4]; // x, y, w, h, in clip space
+	GLfloat uv[4]; // s, t, w, h, in 0-1 tex coords
+	GLfloat layer;
+	GLfloat mult[4], add[4];
+};
+static struct {
+	float scale[2], texScale[2];
+	float layer;
+	float mult[4], add[4];
+} sprState;
+static list<spriteQuad> spriteQueue;
 
 // Where vertexes for a given shape start in our big buffer of vertex data.
 // There's probably a more standard way of doing this!
@@ -103,9 +139,65 @@ static int vtxIdx_poleOneFace = -1;
 static int vtxIdx_cubeSixFace = -1;
 static int vtxIdx_pane = -1;
 
+// Per-instance data for `queueCube`, laid out how `solid.vert` wants it
+struct cubeInstance {
+	GLfloat pos1[3], pos2[3];
+	GLfloat rot1[4], rot2[4];
+	GLfloat scale, alpha;
+	GLfloat layer;
+};
+struct queuedCube {
+	// Which mesh, which is also the order we draw in
+	int key;
+	cubeInstance inst;
+};
+#define NUM_MESHES 4
+static list<queuedCube> cubeQueue;
+static list<cubeInstance> cubeInstances;
+static int cubeKeyStarts[NUM_MESHES+1];
+
+// Per-instance data for `queueBillboard` and `queueTrail`, see `solid.vert` (modes 3 and 4)
+struct particleInstance {
+	GLfloat pos1[3], pos2[3];
+	GLfloat param[4];
+	GLfloat layer, age;
+};
+static list<particleInstance> billboardQueue, trailQueue;
+
+// All our mesh data, same as what's in `buffer_id`
+static list<GLfloat> meshVtxData;
+
+// Static scenery gets baked into one mesh per spatial cell,
+// with vertexes relative to the cell's center (to keep floats happy).
+#define BAKE_CELL_BITS 15
+#define BAKE_STRIDE 10 // pos(3) norm(3) st(2) layer noise_scale
+// Copied out, since callers may hand us a temporary `mover`
+struct bakeMember {
+	offset pos;
+	iquat rot;
+	int64_t scale;
+	int tex, mesh;
+};
+struct bakedChunk {
+	int64_t cell[3];
+	offset origin;
+	// Hash of everything that got added to us since `bakeBegin`, vs what we've got baked
+	uint64_t hash, bakedHash;
+	// Reset by `bakeBegin` (when the stamp changes)
+	list<bakeMember> members;
+	GLuint buf;
+	int numVerts;
+};
+// Sorted by `cell`
+static list<bakedChunk> bakedChunks;
+static int lastBakedChunk;
+static list<GLfloat> bakeVtxData;
+// What `bakedChunks` is currently built from, and whether we're rebuilding it this frame
+static long bakedStamp;
+static char bakeRefilling;
+
 static float matWorldToScreen[16];
 static float camHoverDir[3];
-static list<mover*> camCastCands;
 static float ifovX, ifovY;
 
 static char glMsgBuf[3000]; // Is allocating all of this statically a bad idea? IDK
@@ -145,34 +237,41 @@ static void cerr(const char* msg){
 	}
 }
 
-static void setTexFilterParams() {
+static void setTexFilterParams(GLenum target) {
 	// When evaluating changes to the below filtering settings, you should at least evaluate the two scenarios:
 	//  1. You are on a large, flat plane moving around.
 	//    How crisp is it? How visible is the mipmap and sampling seam? How much does the sampling seam move as you move the camera only?
 	//  2. There is a large object moving in the distance.
 	//    How crisp is it? How does it look as it approaches the threshold of minification->magnification? Is there significant aliasing shimmer?
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 }
 
-static void drawDyntex(GLuint tex, dyntex_description *_descr) {
-	dyntex_description &descr = *_descr;
-	int width = 128, height = 128;
+static void genLayerMips(int layer) {
+	GLuint &view = texLayerViews[layer];
+	if (!view) {
+		glGenTextures(1, &view);
+		glTextureView(view, GL_TEXTURE_2D, texArray, GL_RGBA8, 0, TEX_LEVELS, layer, 1);
+	}
+	// Unit 2 is only ever used for this. `texArray` itself stays on unit 0.
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, view);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+}
 
-	glBindTexture(GL_TEXTURE_2D, tex);
-	// One tutorial used GL_NEAREST for both filtering modes while drawing to the tex,
-	// but IDK how much it matters. Going to just assign the final params now and
-	// assume it's good enough for this phase as well.
-	setTexFilterParams();
-	glTexImage2D(
-		GL_TEXTURE_2D, 0, GL_RGBA8,
-		width, height,
-		0,
-		GL_RGBA, GL_UNSIGNED_BYTE, NULL
-	);
+static void drawDyntex(int layer, dyntex_description *_descr) {
+	dyntex_description &descr = *_descr;
+	int width = TEX_RES, height = TEX_RES;
 
+	// We can't draw straight into `texArray`, since we're also sampling from it
+	// (GL doesn't care that it's a different layer). So we draw into the scratch
+	// texture and copy it over after.
+	// Any sprites already queued are meant for the screen, so they have to go out before we switch.
+	flush2d();
 	glBindFramebuffer(GL_FRAMEBUFFER, fb_id);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dyntexScratch, 0);
 	glDrawBuffer(GL_COLOR_ATTACHMENT0);
 	glViewport(0, 0, width, height);
 
@@ -183,7 +282,7 @@ static void drawDyntex(GLuint tex, dyntex_description *_descr) {
 
 	// Sadly we don't have access to nice stuff like `glCopyImageSubData`,
 	// so I'm just going to draw the texture onto the texture.
-	glUniform2f(u_spr_scale, 1, 1);
+	sprState.scale[0] = sprState.scale[1] = 1;
 	selectTex2d(descr.baseTex, 2, 2);
 	sprite2d(0, 2, 2, 2, -1, -1); // Ugh y is still flipped here I hate everything
 
@@ -206,9 +305,12 @@ static void drawDyntex(GLuint tex, dyntex_description *_descr) {
 	// Conveniently, the back of the player is centered on the sprite,
 	// so centering on the back is easy.
 	drawTextCentered(descr.str, 64);
+	// Likewise, everything we queued has to land in the scratch texture, before we copy it or switch back
+	flush2d();
 
-	glBindTexture(GL_TEXTURE_2D, tex);
-	glGenerateMipmap(GL_TEXTURE_2D);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, 0, 0, width, height);
+	genLayerMips(layer);
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0); // Bind back to screen's framebuffer
 	// Probably need to restore this
@@ -230,32 +332,42 @@ void newDyntexHolder(dyntex_holder *h) {
 		if (t.descr.baseTex != h->descr.baseTex) continue;
 		if (strcmp(t.descr.str, h->descr.str)) continue;
 		// We have a match
-		h->tex = t.tex;
+		h->tex = t.layer;
 		t.holders++;
 		return;
 	}
-	// No match, have to allocate (and draw) a new texture
+	// No match, have to find a free layer and draw a new texture there
+	int layer = NUM_TEXS;
+	for (; layer < TEX_LAYERS; layer++) {
+		rangeconst(i, dyntexs.num) {
+			if (dyntexs[i].layer == layer) goto taken;
+		}
+		break;
+		taken:;
+	}
+	if (layer == TEX_LAYERS) {
+		// `oldDyntexHolder` won't find this in `dyntexs`, so it's fine to just hand this out
+		printf("Out of dyntex layers, falling back to plain tex %d\n", h->descr.baseTex);
+		h->tex = h->descr.baseTex;
+		return;
+	}
 	dyntex_texture &t = dyntexs.add();
-	// I feel like I should check that this succeeded,
-	// but I'm not clear on when it would even fail!
-	// Neither `glGenTextures` nor `glBindTexture`
-	// describe any such errors.
-	glGenTextures(1, &t.tex);
+	t.layer = layer;
 	t.holders = 1;
 	// Copy description wholesale
 	t.descr = h->descr;
 
-	h->tex = t.tex;
-	drawDyntex(t.tex, &t.descr);
+	h->tex = t.layer;
+	drawDyntex(t.layer, &t.descr);
 }
 
 void oldDyntexHolder(dyntex_holder *h) {
 	rangeconst(i, dyntexs.num) {
 		dyntex_texture &t = dyntexs[i];
-		if (h->tex != t.tex) continue;
+		if ((int)h->tex != t.layer) continue;
 		t.holders--;
 		if (!t.holders) {
-			glDeleteTextures(1, &t.tex);
+			// Nothing to free, the layer just gets reused next time
 			dyntexs.quickRmAt(i);
 		}
 		return;
@@ -286,30 +398,74 @@ static GLuint mkShader(GLenum type, const char* path) {
 	return shader;
 }
 
-static void loadTexture(int i) {
+static void requestTexture(int i) {
 	if (!texSrcFiles[i]) return;
-	char *imageData;
-	int width, height;
 	char path[200];
 	snprintf(path, 200, "assets/%s", texSrcFiles[i]);
-	png_read(&imageData, &width, &height, path);
-	if (!imageData) {
-		printf("Not loading texture %d\n", i);
-	} else {
-		glBindTexture(GL_TEXTURE_2D, textures[i]);
-		// (TODO wtf did I ever mean here)
-		// We're going to assume the correct texture is bound!
-		// That's the nice thing about only using one texture.
-		glTexImage2D(
-			GL_TEXTURE_2D, 0, GL_RGBA8,
-			width, height,
-			0,
-			GL_RGBA, GL_UNSIGNED_BYTE, imageData
+	texload_request(i, ++texRequestSeq[i], path);
+}
+
+static void uploadTexture(int layer, uint32_t const *pixels) {
+	// `glBufferData` orphans whatever the last upload was using, so we never wait on it.
+	// `texArray` is always bound to unit 0.
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texUploadPbo);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, TEX_RES*TEX_RES*sizeof(uint32_t), pixels, GL_STREAM_DRAW);
+	glTexSubImage3D(
+		GL_TEXTURE_2D_ARRAY, 0,
+		0, 0, layer,
+		TEX_RES, TEX_RES, 1,
+		GL_RGBA, GL_UNSIGNED_BYTE, (void*)0
+	);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	genLayerMips(layer);
+}
+
+static void finishTextureLoad(texload_result const &r) {
+	// Failed loads keep whatever was there before (placeholder or old image)
+	if (r.pixels && r.seq == texRequestSeq[r.layer]) {
+		uploadTexture(r.layer, r.pixels);
+		// Dyntexs are drawn over their base tex (with the font), so they're stale now too
+		rangeconst(i, dyntexs.num) {
+			dyntex_texture &t = dyntexs[i];
+			if (r.layer == TEX_FONT || t.descr.baseTex == r.layer) drawDyntex(t.layer, &t.descr);
+		}
+	}
+	free(r.pixels);
+}
+
+static void pollTextureLoads() {
+	texload_result r;
+	range(i, TEX_UPLOADS_PER_FRAME) {
+		if (!texload_poll(&r, 0)) return;
+		finishTextureLoad(r);
+	}
+}
+
+void gfx_finishTextureLoads() {
+	texload_result r;
+	while (texload_poll(&r, 1)) finishTextureLoad(r);
+}
+
+static void loadPlaceholders() {
+	// Grey checkers, so it's obvious what hasn't loaded yet.
+	// The font gets nothing (transparent) instead, since blocks of checkers would be confusing as text.
+	uint32_t *pixels = (uint32_t*)malloc(TEX_RES*TEX_RES*sizeof(uint32_t));
+	for (int i = 1; i < NUM_TEXS; i++) {
+		if (!texSrcFiles[i]) continue;
+		range(y, TEX_RES) {
+			range(x, TEX_RES) {
+				uint32_t checker = ((x/16 + y/16) & 1) ? 0xFF909090 : 0xFF606060;
+				pixels[x + TEX_RES*y] = i == TEX_FONT ? 0 : checker;
+			}
+		}
+		glTexSubImage3D(
+			GL_TEXTURE_2D_ARRAY, 0,
+			0, 0, i,
+			TEX_RES, TEX_RES, 1,
+			GL_RGBA, GL_UNSIGNED_BYTE, pixels
 		);
-		// Apparently you can set manual mipmaps, but we don't care about that much
-		glGenerateMipmap(GL_TEXTURE_2D);
 	}
-	free(imageData);
+	free(pixels);
 }
 
 static void loadMottleTex() {
@@ -324,7 +480,7 @@ static void loadMottleTex() {
 		tex_noise_data[idx] = rstate & 0xFF;
 	}
 	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, textures[TEX_MOTTLE]);
+	glBindTexture(GL_TEXTURE_2D, mottleTex);
 	glTexImage2D(
 		GL_TEXTURE_2D, 0, GL_R8,
 		res, res,
@@ -337,12 +493,26 @@ static void loadMottleTex() {
 
 static void loadAllTextures() {
 	loadMottleTex();
-	for (int i = 1; i < NUM_TEXS; i++) loadTexture(i);
+	loadPlaceholders();
+	// Just once for the placeholders, after this it's one layer at a time as images arrive
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	for (int i = 1; i < NUM_TEXS; i++) requestTexture(i);
 }
 
 void initGraphics() {
 	dyntexs.init();
-	camCastCands.init();
+	cubeQueue.init();
+	cubeInstances.init();
+	spriteQueue.init();
+	billboardQueue.init();
+	trailQueue.init();
+	meshVtxData.init();
+	bakedChunks.init();
+	lastBakedChunk = 0;
+	bakeVtxData.init();
+	// Stamps start at 1, so this is never current
+	bakedStamp = 0;
+	bakeRefilling = 0;
 
 	GLuint vertexShader = mkShader(GL_VERTEX_SHADER, "shaders/solid.vert");
 	GLuint spriteShader = mkShader(GL_VERTEX_SHADER, "shaders/sprite.vert");
@@ -373,8 +543,23 @@ void initGraphics() {
 	GLint a_pos_id = attrib(main_prog, "a_pos");
 	GLint a_norm_id = attrib(main_prog, "a_norm");
 	GLint a_tex_st_id = attrib(main_prog, "a_tex_st");
+	GLint a_i_pos1_id = attrib(main_prog, "a_i_pos1");
+	GLint a_i_pos2_id = attrib(main_prog, "a_i_pos2");
+	GLint a_i_rot1_id = attrib(main_prog, "a_i_rot1");
+	GLint a_i_rot2_id = attrib(main_prog, "a_i_rot2");
+	GLint a_i_scale_alpha_id = attrib(main_prog, "a_i_scale_alpha");
+	GLint a_i_layer_id = attrib(main_prog, "a_i_layer");
+	GLint a_b_layer_id = attrib(main_prog, "a_b_layer");
+	GLint a_b_noise_scale_id = attrib(main_prog, "a_b_noise_scale");
+	GLint a_p_param_id = attrib(main_prog, "a_p_param");
+	GLint a_p_age_id = attrib(main_prog, "a_p_age");
 	// sprite_prog attribs
 	GLint a_spr_loc = attrib(sprite_prog, "a_loc");
+	GLint a_q_rect_id = attrib(sprite_prog, "a_q_rect");
+	GLint a_q_uv_id = attrib(sprite_prog, "a_q_uv");
+	GLint a_q_layer_id = attrib(sprite_prog, "a_q_layer");
+	GLint a_q_c_mult_id = attrib(sprite_prog, "a_q_c_mult");
+	GLint a_q_c_add_id = attrib(sprite_prog, "a_q_c_add");
 
 	// Uniforms
 	u_main_modelview    = glGetUniformLocation(main_prog, "u_modelview");
@@ -384,14 +569,11 @@ void initGraphics() {
 	u_main_tex_offset   = glGetUniformLocation(main_prog, "u_tex_offset");
 	u_main_tint         = glGetUniformLocation(main_prog, "u_tint");
 	u_main_transparency = glGetUniformLocation(main_prog, "u_transparency");
-	// sprite_prog uniforms
-	u_spr_size          = glGetUniformLocation(sprite_prog, "u_size");
-	u_spr_scale         = glGetUniformLocation(sprite_prog, "u_scale");
-	u_spr_screen_offset = glGetUniformLocation(sprite_prog, "u_offset");
-	u_spr_tex_scale     = glGetUniformLocation(sprite_prog, "u_tex_scale");
-	u_spr_tex_offset    = glGetUniformLocation(sprite_prog, "u_tex_offset");
-	u_spr_color_mult    = glGetUniformLocation(sprite_prog, "u_c_mult");
-	u_spr_color_add     = glGetUniformLocation(sprite_prog, "u_c_add");
+	u_main_mode         = glGetUniformLocation(main_prog, "u_mode");
+	u_main_world_to_screen = glGetUniformLocation(main_prog, "u_world_to_screen");
+	u_main_interp       = glGetUniformLocation(main_prog, "u_interp");
+	u_main_layer        = glGetUniformLocation(main_prog, "u_layer");
+	u_main_billboard    = glGetUniformLocation(main_prog, "u_billboard");
 
 	// Previously I checked that some uniforms are in the same spots across programs here,
 	// and log + set startupFailed=1 if not.
@@ -406,11 +588,13 @@ void initGraphics() {
 	}
 
 	glEnable(GL_CULL_FACE);
-	glGenVertexArrays(2, vaos);
-	glGenTextures(NUM_TEXS, textures);
+	glGenVertexArrays(5, vaos);
+	glGenTextures(1, &texArray);
+	glGenTextures(1, &mottleTex);
+	glGenTextures(1, &dyntexScratch);
 
-	list<GLfloat> vtxData;
-	vtxData.init();
+	// We keep `meshVtxData` around afterwards, since baking needs a CPU-side copy
+	list<GLfloat> &vtxData = meshVtxData;
 	vtxIdx_cubeOneFace = 0;
 	populateCubeVertexData(&vtxData, 1, 1, 1);
 	vtxIdx_slabOneFace = vtxData.num / 8; // 8 is our "stride", I think it's called
@@ -435,7 +619,6 @@ void initGraphics() {
 	glGenBuffers(1, &buffer_id);
 	glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*vtxData.num, vtxData.items, GL_STATIC_DRAW);
-	vtxData.destroy();
 
 	// Position data is first
 	glVertexAttribPointer(a_pos_id, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 8, (void*) 0);
@@ -445,6 +628,69 @@ void initGraphics() {
 	glVertexAttribPointer(a_tex_st_id, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 8, (void*) (sizeof(GLfloat) * 6));
 	cerr("End of vao 0 prep");
 
+	// vaos[2]
+	// Same per-vertex stuff as vaos[0], plus per-instance stuff from a buffer we refill every frame.
+	// Keeping this separate means the regular draws never have instanced attributes enabled.
+	glBindVertexArray(vaos[2]);
+	glEnableVertexAttribArray(a_pos_id);
+	glEnableVertexAttribArray(a_norm_id);
+	glEnableVertexAttribArray(a_tex_st_id);
+	glVertexAttribPointer(a_pos_id, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 8, (void*) 0);
+	glVertexAttribPointer(a_norm_id, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 8, (void*) (sizeof(GLfloat) * 3));
+	glVertexAttribPointer(a_tex_st_id, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 8, (void*) (sizeof(GLfloat) * 6));
+
+	glGenBuffers(1, &inst_buffer_id);
+	glBindBuffer(GL_ARRAY_BUFFER, inst_buffer_id);
+	GLint instAttribs[6] = {a_i_pos1_id, a_i_pos2_id, a_i_rot1_id, a_i_rot2_id, a_i_scale_alpha_id, a_i_layer_id};
+	int instSizes[6] = {3, 3, 4, 4, 2, 1};
+	int instOffset = 0;
+	range(i, 6) {
+		glEnableVertexAttribArray(instAttribs[i]);
+		glVertexAttribPointer(instAttribs[i], instSizes[i], GL_FLOAT, GL_FALSE, sizeof(cubeInstance), (void*) (sizeof(GLfloat) * instOffset));
+		glVertexAttribDivisor(instAttribs[i], 1);
+		instOffset += instSizes[i];
+	}
+	cerr("End of vao 2 prep");
+
+	// vaos[3]
+	// Baked chunks each have their own buffer, so we only set up the format here
+	// and `glBindVertexBuffer` whichever chunk we're drawing.
+	glBindVertexArray(vaos[3]);
+	GLint bakedAttribs[5] = {a_pos_id, a_norm_id, a_tex_st_id, a_b_layer_id, a_b_noise_scale_id};
+	int bakedSizes[5] = {3, 3, 2, 1, 1};
+	int bakedOffset = 0;
+	range(i, 5) {
+		glEnableVertexAttribArray(bakedAttribs[i]);
+		glVertexAttribFormat(bakedAttribs[i], bakedSizes[i], GL_FLOAT, GL_FALSE, sizeof(GLfloat) * bakedOffset);
+		glVertexAttribBinding(bakedAttribs[i], 0);
+		bakedOffset += bakedSizes[i];
+	}
+	cerr("End of vao 3 prep");
+
+	// vaos[4]
+	// Like vaos[2], but with the billboard / trail instance layout
+	glBindVertexArray(vaos[4]);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+	glEnableVertexAttribArray(a_pos_id);
+	glEnableVertexAttribArray(a_norm_id);
+	glEnableVertexAttribArray(a_tex_st_id);
+	glVertexAttribPointer(a_pos_id, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 8, (void*) 0);
+	glVertexAttribPointer(a_norm_id, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 8, (void*) (sizeof(GLfloat) * 3));
+	glVertexAttribPointer(a_tex_st_id, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 8, (void*) (sizeof(GLfloat) * 6));
+
+	glGenBuffers(1, &particle_buffer_id);
+	glBindBuffer(GL_ARRAY_BUFFER, particle_buffer_id);
+	GLint particleAttribs[5] = {a_i_pos1_id, a_i_pos2_id, a_p_param_id, a_i_layer_id, a_p_age_id};
+	int particleSizes[5] = {3, 3, 4, 1, 1};
+	int particleOffset = 0;
+	range(i, 5) {
+		glEnableVertexAttribArray(particleAttribs[i]);
+		glVertexAttribPointer(particleAttribs[i], particleSizes[i], GL_FLOAT, GL_FALSE, sizeof(particleInstance), (void*) (sizeof(GLfloat) * particleOffset));
+		glVertexAttribDivisor(particleAttribs[i], 1);
+		particleOffset += particleSizes[i];
+	}
+	cerr("End of vao 4 prep");
+
 	// vaos[1]
 	glBindVertexArray(vaos[1]);
 	glEnableVertexAttribArray(a_spr_loc);
@@ -452,6 +698,18 @@ void initGraphics() {
 	glBindBuffer(GL_ARRAY_BUFFER, spr_buffer_id);
 	populateSpriteVertexData();
 	glVertexAttribPointer(a_spr_loc, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 2, (void*) 0);
+	// Plus one instance per queued quad, same idea as vaos[2]
+	glGenBuffers(1, &spr_inst_buffer_id);
+	glBindBuffer(GL_ARRAY_BUFFER, spr_inst_buffer_id);
+	GLint quadAttribs[5] = {a_q_rect_id, a_q_uv_id, a_q_layer_id, a_q_c_mult_id, a_q_c_add_id};
+	int quadSizes[5] = {4, 4, 1, 4, 4};
+	int quadOffset = 0;
+	range(i, 5) {
+		glEnableVertexAttribArray(quadAttribs[i]);
+		glVertexAttribPointer(quadAttribs[i], quadSizes[i], GL_FLOAT, GL_FALSE, sizeof(spriteQuad), (void*) (sizeof(GLfloat) * quadOffset));
+		glVertexAttribDivisor(quadAttribs[i], 1);
+		quadOffset += quadSizes[i];
+	}
 	cerr("End of vao 1 prep");
 
 	/*
@@ -467,11 +725,20 @@ void initGraphics() {
 	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-	range(i, NUM_TEXS) {
-		glBindTexture(GL_TEXTURE_2D, textures[i]);
-		setTexFilterParams();
-	}
-
+	// `texArray` stays bound to unit 0 forever, nobody else uses GL_TEXTURE_2D_ARRAY.
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texArray);
+	setTexFilterParams(GL_TEXTURE_2D_ARRAY);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, TEX_LEVELS, GL_RGBA8, TEX_RES, TEX_RES, TEX_LAYERS);
+	glBindTexture(GL_TEXTURE_2D, mottleTex);
+	setTexFilterParams(GL_TEXTURE_2D);
+	// Only ever a render target, so no mips
+	glBindTexture(GL_TEXTURE_2D, dyntexScratch);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, TEX_RES, TEX_RES);
+	// Don't leave it bound anywhere, so drawing to it never looks like a feedback loop
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenBuffers(1, &texUploadPbo);
+	texload_init(TEX_RES);
 	loadAllTextures();
 
 	glClearColor(0.2, 0.2, 0.2, 1);
@@ -489,19 +756,27 @@ void initGraphics() {
 }
 
 void gfx_destroy() {
-	camCastCands.destroy();
 
 	// At this poing the gfx thread is already killed, so
 	// probably no point in trying to tell GL we're done
 	// with these textures. We don't return our "static"
 	// textures anyway!
+	texload_destroy();
 	dyntexs.destroy();
+	cubeQueue.destroy();
+	cubeInstances.destroy();
+	spriteQueue.destroy();
+	billboardQueue.destroy();
+	trailQueue.destroy();
+	meshVtxData.destroy();
+	rangeconst(i, bakedChunks.num) bakedChunks[i].members.destroy();
+	bakedChunks.destroy();
+	bakeVtxData.destroy();
 
 	// All threads are stopped, and all gamestates have been destroyed.
 	// Clean up any messages, whichever list they're in.
 	cleanupAll(msgs_game);
 	cleanupAll(msgs_gfx);
-	cleanupAll(msgs_exchange);
 	// `main.cpp` cleans up the lists themselves.
 }
 
@@ -513,8 +788,9 @@ static void checkReload() {
 
 	// Skip mottle tex, it isn't read from file
 	for (int i = 1; i < NUM_TEXS; i++) {
-		if (!strcmp(texReloadPath, texSrcFiles[i])) {
-			loadTexture(i);
+		if (texSrcFiles[i] && !strcmp(texReloadPath, texSrcFiles[i])) {
+			// Decoded off-thread, `pollTextureLoads` picks it up when it's ready
+			requestTexture(i);
 			goto success;
 		}
 	}
@@ -525,9 +801,7 @@ static void checkReload() {
 	texReloadFlag.store(0, std::memory_order::release);
 }
 
-static float calcCamDist(float *matWorldToCam, offset const p1, offset const p2, box *prox, float fovInverse, int64_t hovDist) {
-	camCastCands.num = 0;
-	velbox_query_ts(prox, &camCastCands);
+static float calcCamDist(float *matWorldToCam, offset const p1, offset const p2, rayBatch *camTargets, float fovInverse, int64_t hovDist) {
 	unitvec dir;
 	range(i, 3) dir[i] = camHoverDir[i]*FIXP;
 	float y = GFX_Z_NEAR;
@@ -559,12 +833,8 @@ static float calcCamDist(float *matWorldToCam, offset const p1, offset const p2,
 		corners2[3][i] = p2[i] + d;
 	}
 	fraction best = {.numer=hovDist, .denom=FIXP};
-	rangeconst(i, camCastCands.num) {
-		mover *m = camCastCands[i];
-		range(j, 4) {
-			raycast_interp(&best, m, corners1[j], corners2[j], dir, gfx_interpRatio);
-		}
-	}
+	// Players aren't in the velbox tree when we render, and the camera never bumped into them before either
+	camTargets->cast(&best, 4, corners1, corners2, dir, NULL, 1);
 	return (float)best.numer*FIXP/best.denom;
 }
 
@@ -573,8 +843,9 @@ void reset3dTexScale() {
 	glUniform2f(u_main_tex_scale, 1, 1);
 }
 
-void setupFrame(int64_t const *p1, int64_t const *p2, box *prox, lookConfig *lookCfg) {
+void setupFrame(int64_t const *p1, int64_t const *p2, rayBatch *camTargets, lookConfig *lookCfg) {
 	checkReload();
+	pollTextureLoads();
 	glUseProgram(main_prog);
 	glBindVertexArray(vaos[0]);
 	glDepthMask(1);
@@ -604,8 +875,8 @@ void setupFrame(int64_t const *p1, int64_t const *p2, box *prox, lookConfig *loo
 
 	memcpy(gfx_camPos1, p1, sizeof(offset));
 	memcpy(gfx_camPos2, p2, sizeof(offset));
-	if (prox && lookCfg->hovDist) {
-		gfx_camDist = calcCamDist(matWorldToCam, p1, p2, prox, lookCfg->fovInv, lookCfg->hovDist);
+	if (camTargets && lookCfg->hovDist) {
+		gfx_camDist = calcCamDist(matWorldToCam, p1, p2, camTargets, lookCfg->fovInv, lookCfg->hovDist);
 		// Previously I'd use `p1` and `p2` directly and just set
 		// `gfx_camDist` into `matWorldToCam[13]`. This was neat,
 		// but meant our calculations for how to draw trails were
@@ -645,16 +916,21 @@ void tint(float r, float g, float b, float a) {
 	glUniform4f(u_main_tint, _r, _g, _b, _a);
 }
 
-void sprite_color_mult(float r, float g, float b, float a) {
-	glUniform4f(u_spr_color_mult, r, g, b, a);
-}
-
-void sprite_color_add(float r, float g, float b, float a) {
-	glUniform4f(u_spr_color_add, r, g, b, a);
+static int32_t meshVtxIdx(int mode) {
+	if (mode == 0) {
+		return vtxIdx_cubeOneFace;
+	} else if (mode == 1) {
+		return vtxIdx_slabOneFace;
+	} else if (mode == 2) {
+		return vtxIdx_poleOneFace;
+	} else {
+		return vtxIdx_cubeSixFace;
+	}
 }
 
 void drawCube(mover *m, int64_t scale, int tex, int mode, float alpha) {
 	if (mode & 32) {
+		// `tex` is a dyntex layer, not one of the usual textures
 		mode &= ~32;
 	} else {
 #ifdef DEBUG
@@ -663,7 +939,6 @@ void drawCube(mover *m, int64_t scale, int tex, int mode, float alpha) {
 			exit(1);
 		}
 #endif
-		tex = textures[tex];
 	}
 
 	// The rotation of the thing itself (used for lighting).
@@ -691,120 +966,309 @@ void drawCube(mover *m, int64_t scale, int tex, int mode, float alpha) {
 	glUniformMatrix4fv(u_main_modelview, 1, GL_FALSE, matScreen);
 
 	// Set texture and tex-related uniforms
-	glBindTexture(GL_TEXTURE_2D, tex); // Is this okay to be doing so often? Hope so!
+	glUniform1f(u_main_layer, tex);
 	glUniform1f(u_main_noise_scale, scale/1000.0);
 	glUniform1f(u_main_transparency, alpha);
 
-	int32_t vertexIndex;
-	if (mode == 0) {
-		vertexIndex = vtxIdx_cubeOneFace;
-	} else if (mode == 1) {
-		vertexIndex = vtxIdx_slabOneFace;
-	} else if (mode == 2) {
-		vertexIndex = vtxIdx_poleOneFace;
-	} else {
-		vertexIndex = vtxIdx_cubeSixFace;
-	}
-
 	// For now, all our meshes have the same number of vertices:
 	// 6 faces * 2 tris/face * 3 vtx/tri = 36 vertexes to draw
-	glDrawArrays(GL_TRIANGLES, vertexIndex, 36);
+	glDrawArrays(GL_TRIANGLES, meshVtxIdx(mode), 36);
 }
 
-void drawBillboard(offset p1, offset p2, int tex, float x, float y, float w, int64_t r) {
-	glBindTexture(GL_TEXTURE_2D, textures[tex]);
-	glUniform1f(u_main_noise_scale, 1);
-	glUniform2f(u_main_tex_offset, x, y);
-	glUniform2f(u_main_tex_scale, w, w);
-	glUniform1f(u_main_transparency, 1.0);
-	// We skip `u_main_rot` - it's just for lighting,
-	// and the "pane" mesh's normals are all 0 anyway.
-
-	// TODO I'm sure I can do better than a matrix mult where almost everything is 0 lol
-	float matWorld[16] = {0};
-	matWorld[15] = 1;
+void queueCube(mover const *m, int64_t scale, int tex, int mesh, float alpha) {
+#ifdef DEBUG
+	if (tex < 0 || tex >= NUM_TEXS) {
+		printf("ERROR: Invalid tex %d\n", tex);
+		exit(1);
+	}
+#endif
+	if (mesh >= NUM_MESHES) mesh = NUM_MESHES-1;
+	queuedCube &q = cubeQueue.add();
+	q.key = mesh;
+	cubeInstance &c = q.inst;
+	// Same as what `drawCube` does, except the interpolation happens in the shader
 	range(i, 3) {
-		int64_t x1 = p1[i] - gfx_camPos1[i];
-		int64_t x2 = p2[i] - gfx_camPos2[i];
-		matWorld[12+i] = x1 + gfx_interpRatio*(x2-x1);
+		c.pos1[i] = m->oldPos[i] - gfx_camPos1[i];
+		c.pos2[i] = m->pos[i]    - gfx_camPos2[i];
 	}
-	float matScreen[16];
-	mat4Multf(matScreen, matWorldToScreen, matWorld);
+	range(i, 4) {
+		c.rot1[i] = (float)m->oldRot[i]/FIXP;
+		c.rot2[i] = (float)m->rot[i]/FIXP;
+	}
+	c.scale = scale;
+	c.alpha = alpha;
+	c.layer = tex;
+}
 
-	matScreen[0] = r*ifovX;
-	matScreen[9] = r*ifovY;
-	glUniformMatrix4fv(u_main_modelview, 1, GL_FALSE, matScreen);
+void flushCubes() {
+	if (!cubeQueue.num) return;
+
+	// Counting sort by key, so each mesh is one contiguous run
+	memset(cubeKeyStarts, 0, sizeof(cubeKeyStarts));
+	rangeconst(i, cubeQueue.num) cubeKeyStarts[cubeQueue[i].key+1]++;
+	range(i, NUM_MESHES) cubeKeyStarts[i+1] += cubeKeyStarts[i];
+	cubeInstances.setMaxUp(cubeQueue.num);
+	cubeInstances.num = cubeQueue.num;
+	// Placing things bumps each key's start up to its end,
+	// so afterwards `cubeKeyStarts[k]` is where key `k` ends (and key `k+1` starts).
+	rangeconst(i, cubeQueue.num) {
+		queuedCube &q = cubeQueue[i];
+		cubeInstances[cubeKeyStarts[q.key]++] = q.inst;
+	}
 
-	glDrawArrays(GL_TRIANGLES, vtxIdx_pane, 6);
+	glBindVertexArray(vaos[2]);
+	glBindBuffer(GL_ARRAY_BUFFER, inst_buffer_id);
+	// Re-specifying the whole thing each time lets the driver hand us fresh storage
+	// instead of waiting on whatever the GPU is still reading from last time.
+	glBufferData(GL_ARRAY_BUFFER, sizeof(cubeInstance)*cubeInstances.num, cubeInstances.items, GL_STREAM_DRAW);
+	glUniform1i(u_main_mode, 1);
+	glUniform1f(u_main_interp, gfx_interpRatio);
+	glUniformMatrix4fv(u_main_world_to_screen, 1, GL_FALSE, matWorldToScreen);
+
+	int start = 0;
+	range(key, NUM_MESHES) {
+		int end = cubeKeyStarts[key];
+		if (end == start) continue;
+		// Textures are per-instance, so there's nothing to switch between draws
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLES, meshVtxIdx(key), 36, end-start, start);
+		start = end;
+	}
+
+	glUniform1i(u_main_mode, 0);
+	glBindVertexArray(vaos[0]);
+	cubeQueue.num = 0;
 }
 
-void drawTrail(offset const start, unitvec const dir, int64_t len, float age_interp) {
-	glDepthMask(0);
-	glBindTexture(GL_TEXTURE_2D, textures[TEX_TRAIL]);
-	glUniform1f(u_main_noise_scale, 1);
-	glUniform2f(u_main_tex_scale, 1, 0);
-	glUniform1f(u_main_transparency, 1.0-age_interp);
-	// We skip `u_main_rot` - it's just for lighting,
-	// and the "pane" mesh's normals are all 0 anyway.
-	float matWorld[16];
-	float * const sideways = matWorld;
-	// Our "trail" mesh doesn't have any nonzero Y components, so we don't bother with `matWorld+4`.
-	float * const forward = matWorld+8;
-	float * const translate = matWorld+12;
-	// Fill in the other spaces in the matrix...
-	matWorld[3] = 0;
-	matWorld[4] = matWorld[5] = matWorld[6] = matWorld[7] = 0;
-	matWorld[11] = 0;
-	matWorld[15] = 1;
-
-	// `forward` and `translate` we can produce without much fuss.
-	range(i, 3) forward[i] = (float)dir[i]*len/(FIXP*2);
-	range(i, 3) {
-		// These `cam` values don't depend on the trail, so I guess I could pre-calculate them
-		// if that actually represented any useful savings. Things that aren't trails don't use
-		// these values, since they don't play well with floats at high speeds. Trails don't
-		// move though, so they won't play well at high speeds anyway.
-		int64_t cam = gfx_camPos1[i] + gfx_interpRatio*(gfx_camPos2[i]-gfx_camPos1[i]);
-		translate[i] = start[i]-cam+forward[i];
+static uint64_t hashMix(uint64_t h, uint64_t x) {
+	h = (h ^ x) * 0x9E3779B97F4A7C15;
+	return h ^ (h >> 32);
+}
+
+// Returns where a chunk for `cell` is (or would go) in `bakedChunks`
+static int findBakedChunk(int64_t const cell[3], char *found) {
+	int lo = 0, hi = bakedChunks.num;
+	while (lo < hi) {
+		int mid = (lo+hi)/2;
+		int64_t *c = bakedChunks[mid].cell;
+		int cmp = 0;
+		range(i, 3) {
+			if (c[i] != cell[i]) {
+				cmp = c[i] < cell[i] ? -1 : 1;
+				break;
+			}
+		}
+		if (!cmp) {
+			*found = 1;
+			return mid;
+		}
+		if (cmp < 0) lo = mid+1;
+		else hi = mid;
 	}
-	// `sideways` is the trickiest to produce,
-	// since it depends on the angle you're looking at the trail from.
-	float fdir[3];
-	range(i, 3) fdir[i] = dir[i]*(0.5/FIXP); // scale factor here relates to distance from trail
-	cross(sideways, translate, fdir);
-	float magnitude = sqrt(sideways[0]*sideways[0] + sideways[1]*sideways[1] + sideways[2]*sideways[2]);
-	float trail_width = -10.0f/(age_interp+0.1f)+110.0f;
-	// If camera lines up too closely w/ trail,
-	// it will shrink to nothing,
-	// instead of spinning around dramatically as the camera makes its near approach
-	if (magnitude > trail_width) {
-		float x = trail_width/magnitude;
-		range(i, 3) sideways[i] *= x;
+	*found = 0;
+	return lo;
+}
+
+char bakeBegin(long stamp) {
+	if (stamp == bakedStamp) return 0;
+	bakedStamp = stamp;
+	bakeRefilling = 1;
+	rangeconst(i, bakedChunks.num) {
+		bakedChunks[i].members.num = 0;
+		bakedChunks[i].hash = 0;
 	}
-	// And finally apply the transform we computed during `setupFrame`
+	return 1;
+}
+
+void bakeCube(mover const *m, int64_t scale, int tex, int mesh) {
+	if (mesh >= NUM_MESHES) mesh = NUM_MESHES-1;
+
+	int64_t cell[3];
+	range(i, 3) cell[i] = m->pos[i] >> BAKE_CELL_BITS;
+	// Stuff is usually added in big spatially-coherent runs, so try the last chunk first
+	int ix = lastBakedChunk;
+	if (ix >= bakedChunks.num || memcmp(bakedChunks[ix].cell, cell, sizeof(cell))) {
+		char found;
+		ix = findBakedChunk(cell, &found);
+		if (!found) {
+			bakedChunk c;
+			memcpy(c.cell, cell, sizeof(cell));
+			range(i, 3) c.origin[i] = (cell[i] << BAKE_CELL_BITS) + (1 << (BAKE_CELL_BITS-1));
+			c.hash = 0;
+			c.bakedHash = 0;
+			c.members.init();
+			c.buf = 0;
+			c.numVerts = 0;
+			bakedChunks.ins(c, ix);
+		}
+		lastBakedChunk = ix;
+	}
+
+	bakedChunk &c = bakedChunks[ix];
+	bakeMember &b = c.members.add();
+	memcpy(b.pos, m->pos, sizeof(offset));
+	memcpy(b.rot, m->rot, sizeof(iquat));
+	b.scale = scale;
+	b.tex = tex;
+	b.mesh = mesh;
+	uint64_t h = c.hash;
+	range(i, 3) h = hashMix(h, m->pos[i]);
+	range(i, 4) h = hashMix(h, m->rot[i]);
+	h = hashMix(h, scale);
+	h = hashMix(h, tex*NUM_MESHES + mesh);
+	c.hash = h;
+}
+
+static void rebake(bakedChunk *c) {
+	bakeVtxData.num = 0;
+	bakeVtxData.setMaxUp(c->members.num * 36 * BAKE_STRIDE);
+	rangeconst(i, c->members.num) {
+		bakeMember &b = c->members[i];
+		float rot[9];
+		mat3FromIquat(rot, b.rot);
+		float translate[3];
+		range(j, 3) translate[j] = b.pos[j] - c->origin[j];
+		GLfloat const *src = &meshVtxData[meshVtxIdx(b.mesh)*8];
+		range(v, 36) {
+			GLfloat const *in = src + v*8;
+			range(j, 3) bakeVtxData.add(b.scale*(rot[j]*in[0] + rot[3+j]*in[1] + rot[6+j]*in[2]) + translate[j]);
+			range(j, 3) bakeVtxData.add(rot[j]*in[3] + rot[3+j]*in[4] + rot[6+j]*in[5]);
+			bakeVtxData.add(in[6]);
+			bakeVtxData.add(in[7]);
+			bakeVtxData.add(b.tex);
+			bakeVtxData.add(b.scale/1000.0);
+		}
+	}
+	if (!c->buf) glGenBuffers(1, &c->buf);
+	glBindBuffer(GL_ARRAY_BUFFER, c->buf);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*bakeVtxData.num, bakeVtxData.items, GL_STATIC_DRAW);
+	c->numVerts = bakeVtxData.num / BAKE_STRIDE;
+	c->bakedHash = c->hash;
+}
+
+void bakeFinish() {
+	// If we just refilled, anything that didn't show up is gone, and anything that changed gets rebaked.
+	// Everything else we can just draw as-is.
+	if (bakeRefilling) {
+		for (int i = 0; i < bakedChunks.num; i++) {
+			bakedChunk &c = bakedChunks[i];
+			if (!c.members.num) {
+				if (c.buf) glDeleteBuffers(1, &c.buf);
+				c.members.destroy();
+				bakedChunks.stableRmAt(i);
+				i--;
+				continue;
+			}
+			if (c.hash != c.bakedHash || !c.buf) rebake(&c);
+		}
+		bakeRefilling = 0;
+	}
+
+	glBindVertexArray(vaos[3]);
+	glUniform1i(u_main_mode, 2);
+	glUniform1f(u_main_transparency, 1.0);
+	float matWorld[16] = {0};
+	matWorld[0] = matWorld[5] = matWorld[10] = matWorld[15] = 1;
 	float matScreen[16];
-	mat4Multf(matScreen, matWorldToScreen, matWorld);
-	glUniformMatrix4fv(u_main_modelview, 1, GL_FALSE, matScreen);
+	rangeconst(i, bakedChunks.num) {
+		bakedChunk &c = bakedChunks[i];
+		range(j, 3) {
+			int64_t x1 = c.origin[j] - gfx_camPos1[j];
+			int64_t x2 = c.origin[j] - gfx_camPos2[j];
+			matWorld[12+j] = x1 + gfx_interpRatio*(x2-x1);
+		}
+		mat4Multf(matScreen, matWorldToScreen, matWorld);
+		glUniformMatrix4fv(u_main_modelview, 1, GL_FALSE, matScreen);
+		glBindVertexBuffer(0, c.buf, 0, sizeof(GLfloat)*BAKE_STRIDE);
+		glDrawArrays(GL_TRIANGLES, 0, c.numVerts);
+	}
+	glUniform1i(u_main_mode, 0);
+	glBindVertexArray(vaos[0]);
+}
 
-	glDrawArrays(GL_TRIANGLES, vtxIdx_pane, 6);
-	glDepthMask(1);
+void queueBillboard(offset const p1, offset const p2, int tex, float x, float y, float w, int64_t r) {
+	particleInstance &b = billboardQueue.add();
+	range(i, 3) {
+		b.pos1[i] = p1[i] - gfx_camPos1[i];
+		b.pos2[i] = p2[i] - gfx_camPos2[i];
+	}
+	b.param[0] = x;
+	b.param[1] = y;
+	b.param[2] = w;
+	b.param[3] = r;
+	b.layer = tex;
+	b.age = 0;
+}
+
+void queueTrail(offset const start, unitvec const dir, int64_t len, float age_interp) {
+	particleInstance &t = trailQueue.add();
+	// Trails don't move, but the camera does; interpolating this in the shader
+	// works out the same as interpolating the camera.
+	range(i, 3) {
+		t.pos1[i] = start[i] - gfx_camPos1[i];
+		t.pos2[i] = start[i] - gfx_camPos2[i];
+		t.param[i] = (float)dir[i]/FIXP;
+	}
+	t.param[3] = (float)len/2;
+	t.layer = TEX_TRAIL;
+	t.age = age_interp;
+}
+
+void flushParticles() {
+	int nb = billboardQueue.num;
+	int nt = trailQueue.num;
+	if (!nb && !nt) return;
+
+	// The shared upload gets counted with whichever kind goes first
+	glcount_section(nb ? GLC_BLASTS : GLC_TRAILS);
+	glBindVertexArray(vaos[4]);
+	glBindBuffer(GL_ARRAY_BUFFER, particle_buffer_id);
+	// Both lists share one buffer, billboards first
+	glBufferData(GL_ARRAY_BUFFER, sizeof(particleInstance)*(nb+nt), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(particleInstance)*nb, billboardQueue.items);
+	glBufferSubData(GL_ARRAY_BUFFER, sizeof(particleInstance)*nb, sizeof(particleInstance)*nt, trailQueue.items);
+	glUniform1f(u_main_interp, gfx_interpRatio);
+	glUniformMatrix4fv(u_main_world_to_screen, 1, GL_FALSE, matWorldToScreen);
+	glUniform2f(u_main_billboard, ifovX, ifovY);
+
+	// Textures are per-instance, so it's one draw for each kind
+	if (nb) {
+		glUniform1i(u_main_mode, 3);
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLES, vtxIdx_pane, 6, nb, 0);
+	}
+	if (nt) {
+		glcount_section(GLC_TRAILS);
+		glDepthMask(0);
+		glUniform1i(u_main_mode, 4);
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLES, vtxIdx_pane, 6, nt, nb);
+		glDepthMask(1);
+	}
+
+	glUniform1i(u_main_mode, 0);
+	glBindVertexArray(vaos[0]);
+	billboardQueue.num = 0;
+	trailQueue.num = 0;
 }
 
 void setup2dDrawing() {
-	glUseProgram(sprite_prog);
-	glBindVertexArray(vaos[1]);
+	// Anything already queued was meant for whatever was set up before (viewport, text scale, etc).
+	// If you're switching framebuffers, `flush2d` yourself before binding the new one.
+	flush2d();
 	spriteColorMult(1, 1, 1, 1);
 	spriteColorAdd(0, 0, 0, 0);
-
-	glDisable(GL_DEPTH_TEST);
 }
 
 void spriteColorMult(float r, float g, float b, float a) {
-	glUniform4f(u_spr_color_mult, r, g, b, a);
+	sprState.mult[0] = r;
+	sprState.mult[1] = g;
+	sprState.mult[2] = b;
+	sprState.mult[3] = a;
 }
 
 void spriteColorAdd(float r, float g, float b, float a) {
-	glUniform4f(u_spr_color_add, r, g, b, a);
+	sprState.add[0] = r;
+	sprState.add[1] = g;
+	sprState.add[2] = b;
+	sprState.add[3] = a;
 }
 
 // Can make variants of this -
@@ -815,7 +1279,8 @@ void spriteColorAdd(float r, float g, float b, float a) {
 void centeredGrid2d(float boundsY) {
 	displayAreaBounds[1] = boundsY;
 	displayAreaBounds[0] = boundsY*displayWidth/displayHeight;
-	glUniform2f(u_spr_scale, 1.0/displayAreaBounds[0], 1.0/displayAreaBounds[1]);
+	sprState.scale[0] = 1.0/displayAreaBounds[0];
+	sprState.scale[1] = 1.0/displayAreaBounds[1];
 }
 
 // `texW` and `texH` are the full width/height of the texture, in pixels.
@@ -826,27 +1291,55 @@ void selectTex2d(int tex, int texW, int texH) {
 		exit(1);
 	}
 #endif
-	glBindTexture(GL_TEXTURE_2D, textures[tex]);
-	glUniform2f(u_spr_tex_scale, 1.0/texW, 1.0/texH);
+	sprState.layer = tex;
+	sprState.texScale[0] = 1.0/texW;
+	sprState.texScale[1] = 1.0/texH;
+}
+
+// Coordinates here are what the old per-sprite uniforms took, see `sprite.vert` for where they end up
+static void queueQuad(float tex_x, float tex_y, float w, float h, float x, float y) {
+	spriteQuad &q = spriteQueue.add();
+	q.rect[0] = sprState.scale[0] * x;
+	q.rect[1] = sprState.scale[1] * y;
+	q.rect[2] = sprState.scale[0] * w;
+	q.rect[3] = sprState.scale[1] * h;
+	q.uv[0] = sprState.texScale[0] * tex_x;
+	q.uv[1] = sprState.texScale[1] * tex_y;
+	q.uv[2] = sprState.texScale[0] * w;
+	q.uv[3] = sprState.texScale[1] * h;
+	q.layer = sprState.layer;
+	memcpy(q.mult, sprState.mult, sizeof(q.mult));
+	memcpy(q.add, sprState.add, sizeof(q.add));
 }
 
 void sprite2d(int spr_off_x, int spr_off_y, int spr_w, int spr_h, float x, float y) {
-	glUniform2f(u_spr_tex_offset, spr_off_x, spr_off_y);
-	glUniform2f(u_spr_size, spr_w, spr_h);
 	// I had some coordinate systems flipped, and had to get that straightened out.
 	// Really I should go through and flip all the callers of this method
 	// so everything finally agrees, but for now I'm just changing this to `-y`.
-	glUniform2f(u_spr_screen_offset, x, -y);
+	queueQuad(spr_off_x, spr_off_y, spr_w, spr_h, x, -y);
+}
+
+void flush2d() {
+	if (!spriteQueue.num) return;
 
-	glDrawArrays(GL_TRIANGLES, 0, 6); // 6 vtx = 2 tri = 1 square
+	glUseProgram(sprite_prog);
+	glBindVertexArray(vaos[1]);
+	glDisable(GL_DEPTH_TEST);
+	glBindBuffer(GL_ARRAY_BUFFER, spr_inst_buffer_id);
+	// Orphan + refill, same as `flushCubes`
+	glBufferData(GL_ARRAY_BUFFER, sizeof(spriteQuad)*spriteQueue.num, spriteQueue.items, GL_STREAM_DRAW);
+	// Every texture is a layer of `texArray`, so it's all one draw, in the order it was queued
+	glDrawArraysInstanced(GL_TRIANGLES, 0, 6, spriteQueue.num); // 6 vtx = 2 tri = 1 square
+	spriteQueue.num = 0;
 }
 
 static void setupTextDrawingInner() {
-	glUniform2f(u_spr_scale, 1.0/displayAreaBounds[0], 1.0/displayAreaBounds[1]);
+	sprState.scale[0] = 1.0/displayAreaBounds[0];
+	sprState.scale[1] = 1.0/displayAreaBounds[1];
 
 	// Our texture is 64x64, and tex coords go 0-1
-	glUniform2f(u_spr_tex_scale, 1.0/64, 1.0/64);
-	glBindTexture(GL_TEXTURE_2D, textures[TEX_FONT]);
+	sprState.texScale[0] = sprState.texScale[1] = 1.0/64;
+	sprState.layer = TEX_FONT;
 
 	spriteColorMult(0.75, 0.75, 0.75, 1);
 }
@@ -872,19 +1365,14 @@ void drawText(char const* str, int x, int y) {
 	// Need to go through and flip callers of this method at some point
 	float cursorY =  displayAreaBounds[1]-y;
 	// Each letter has a blank column copied to the right, but the first blank column (to the left) is done manually.
-	glUniform2f(u_spr_size, 1, 8);
-	glUniform2f(u_spr_screen_offset, cursorX, cursorY);
+	queueQuad(0, 0, 1, 8, cursorX, cursorY);
 	cursorX++;
-	glUniform2f(u_spr_tex_offset, 0, 0);
-	glDrawArrays(GL_TRIANGLES, 0, 6); // 6 vtx = 2 tri = 1 square
-
-	glUniform2f(u_spr_size, 5, 8);
 
 	for (int idx = 0;; idx++){
 		int letter = str[idx];
 		if (!letter) return;
 
-		glUniform2f(u_spr_screen_offset, cursorX, cursorY);
+		float letterX = cursorX;
 		cursorX += 5;
 
 		letter -= 32;
@@ -892,8 +1380,7 @@ void drawText(char const* str, int x, int y) {
 
 		int texRow = letter/12;
 		int texCol = letter%12;
-		glUniform2f(u_spr_tex_offset, 1+texCol*5, 64-texRow*7);
-		glDrawArrays(GL_TRIANGLES, 0, 6); // 6 vtx = 2 tri = 1 square
+		queueQuad(1+texCol*5, 64-texRow*7, 5, 8, letterX, cursorY);
 	}
 }
 
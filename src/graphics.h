@@ -6,6 +6,8 @@ struct lookConfig {
 	u8 aimType; // AIM_ constants defined in game.cpp, graphics shouldn't care.
 };
 
+struct rayBatch;
+
 #define GFX_Z_NEAR 100
 extern float gfx_camDist;
 #define GFX_CAM_DIST_MAX 4000
@@ -26,16 +28,36 @@ extern void oldDyntexHolder(dyntex_holder *h);
 
 extern void initGraphics(); // should be `gfx_init` but this func is old
 extern void gfx_destroy();
+// Textures load in the background; this blocks until everything requested so far is uploaded.
+extern void gfx_finishTextureLoads();
 
 extern void reset3dTexScale();
-extern void setupFrame(int64_t const *p1, int64_t const *p2, box *prox, lookConfig *lookCfg);
+extern void setupFrame(int64_t const *p1, int64_t const *p2, rayBatch *camTargets, lookConfig *lookCfg);
 extern void tint(float r, float g, float b, float a);
 extern void drawCube(mover *m, int64_t scale, int tex, int mesh, float alpha);
+// Like `drawCube`, but nothing is drawn until `flushCubes`, which draws everything
+// queued so far with one instanced draw call per mesh.
+// Doesn't support dyntex skins (`mesh & 32`), and uses whatever `tint` is set at flush time.
+extern void queueCube(mover const *m, int64_t scale, int tex, int mesh, float alpha);
+extern void flushCubes();
+// Static scenery gets baked into per-cell meshes that live on the GPU.
+// Each frame: `bakeBegin` with the scenery's stamp (see `gamestate::sceneryStamp`). Only if that returns 1
+// (the stamp changed) do you `bakeCube` everything static. Then `bakeFinish`, which draws it all.
+// Only cells whose contents changed get rebaked.
+extern char bakeBegin(long stamp);
+extern void bakeCube(mover const *m, int64_t scale, int tex, int mesh);
+extern void bakeFinish();
 
-extern void drawBillboard(offset p1, offset p2, int tex, float x, float y, float w, int64_t r);
-extern void drawTrail(offset const start, unitvec const dir, int64_t len, float age_interp);
+// Same idea as `queueCube`: billboards and trails are queued up,
+// and `flushParticles` draws each kind with one instanced call.
+extern void queueBillboard(offset const p1, offset const p2, int tex, float x, float y, float w, int64_t r);
+extern void queueTrail(offset const start, unitvec const dir, int64_t len, float age_interp);
+extern void flushParticles();
 
+// 2D drawing below just queues quads; `flush2d` draws them all (in order) in one go.
+// Call it once the HUD is done, or before changing render targets.
 extern void setup2dDrawing();
+extern void flush2d();
 extern void spriteColorMult(float r, float g, float b, float a);
 extern void spriteColorAdd(float r, float g, float b, float a);
 
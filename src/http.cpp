@@ -20,6 +20,7 @@ extern char **environ;
 #include "mypoll.h"
 #include "file.h"
 #include "net.h"
+#include "metrics.h"
 
 #include "http.h"
 
@@ -137,6 +138,14 @@ static void writeConfigs(int fd) {
 	buffer.destroy();
 }
 
+static void writeMetrics(int fd) {
+	list<char> buffer;
+	buffer.init();
+	metrics_json(&buffer);
+	write200(fd, buffer.items, buffer.num, "application/json");
+	buffer.destroy();
+}
+
 // Very similar to `cfg_lookup`, but only checks `httpConfigs`, and may return `NULL`.
 static cfg_item* findConfig(char *str) {
 	for (cfg_item **x = httpConfigs; *x; x++) {
@@ -236,6 +245,8 @@ static void read_inner(int fd) {
 		write200(fd, defaultHtml.l.items, defaultHtml.l.num, "text/html");
 	} else if (!strcmp(buf, "/config")) {
 		writeConfigs(fd);
+	} else if (!strcmp(buf, "/metrics")) {
+		writeMetrics(fd);
 	} else if (!strncmp(buf, "/name/", 6)) {
 		// "/name/foo" -> "/name foo"
 		// "/name/" -> "/name"
@@ -0,0 +1,76 @@
+#include <string.h>
+
+#include "util.h"
+
+#include "inputcodec.h"
+
+struct bitWriter {
+	u8 *dest;
+	int bit;
+
+	void put(uint32_t v, int bits) {
+		range(i, bits) {
+			int byte = bit >> 3;
+			if (!(bit & 7)) dest[byte] = 0;
+			dest[byte] |= ((v >> i) & 1) << (bit & 7);
+			bit++;
+		}
+	}
+};
+
+struct bitReader {
+	u8 const *src;
+	int bit, size;
+
+	char get(uint32_t *out, int bits) {
+		if (bit + bits > size*8) return 1;
+		uint32_t v = 0;
+		range(i, bits) {
+			v |= (uint32_t)((src[bit >> 3] >> (bit & 7)) & 1) << i;
+			bit++;
+		}
+		*out = v;
+		return 0;
+	}
+};
+
+// Small magnitudes (of either sign) become small unsigned numbers
+static uint32_t zigzag(int32_t v) {
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t z) {
+	return (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+}
+
+int inputcodec_encode(char *dest, int32_t const *vals, int n) {
+	uint32_t mask = 0;
+	int width = 1;
+	range(i, n) {
+		if (!vals[i]) continue;
+		mask |= 1 << i;
+		uint32_t z = zigzag(vals[i]);
+		while (width < 32 && (z >> width)) width++;
+	}
+	bitWriter w = {.dest = (u8*)dest, .bit = 0};
+	w.put(mask, n);
+	w.put(width - 1, 5);
+	range(i, n) {
+		if (vals[i]) w.put(zigzag(vals[i]), width);
+	}
+	return (w.bit + 7) / 8;
+}
+
+char inputcodec_decode(int32_t *vals, int n, char const *src, int size) {
+	bitReader r = {.src = (u8 const*)src, .bit = 0, .size = size};
+	uint32_t mask, width;
+	if (r.get(&mask, n) || r.get(&width, 5)) return 1;
+	width++;
+	range(i, n) {
+		uint32_t z = 0;
+		if (((mask >> i) & 1) && r.get(&z, width)) return 1;
+		vals[i] = unzigzag(z);
+	}
+	// Anything past the last byte we needed means the sender and us disagree on the format
+	return (r.bit + 7) / 8 != size;
+}
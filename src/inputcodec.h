@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+// Compact, lossless encoding for a small array of int32 fields (like per-frame player inputs).
+// Layout, as a little-endian bitstream:
+//   `n` bits: which fields are non-zero
+//   5 bits: bit width `w` (minus 1) shared by all the non-zero fields
+//   `w` bits per non-zero field: zigzag-encoded value
+// There's no state carried between frames, so anybody can decode any message on its own.
+
+// Worst case: every field non-zero and needing the full 32 bits
+#define INPUTCODEC_MAX_BYTES(n) (((n) + 5 + 32*(n) + 7) / 8)
+
+// Returns the number of bytes written to `dest`
+extern int inputcodec_encode(char *dest, int32_t const *vals, int n);
+// Returns 1 if `src` was malformed (e.g. too short), in which case `vals` may be partially written
+extern char inputcodec_decode(int32_t *vals, int n, char const *src, int size);
@@ -479,9 +479,8 @@ extern void lv_peaks(gamestate *gs) {
 	bctx.peek();
 	// This is basically finalizing the `constel`,
 	// though you could also specify the radius
-	// manually if you knew it. This will only actually
-	// matter once we have an "implicit" state for
-	// constels to go into.
+	// manually if you knew it. This is the radius
+	// used for the instances' aggregate velbox leaf.
 	trolley->estimateRadius();
 
 	constel *bigPlate = mkConstel();
@@ -0,0 +1,108 @@
+#include <string.h>
+
+#include "util.h"
+#include "list.h"
+
+#include "lz.h"
+
+#define HASH_BITS 16
+#define MAX_OFFSET 65535
+
+static uint32_t hash4(u8 const *p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static void putLen(list<char> *dest, int len) {
+	while (len >= 255) {
+		dest->add((char)255);
+		len -= 255;
+	}
+	dest->add((char)len);
+}
+
+static void putSequence(list<char> *dest, u8 const *lits, int numLits, int offset, int matchLen) {
+	int m = matchLen ? matchLen - LZ_MIN_MATCH : 0;
+	int tokLit = numLits < 15 ? numLits : 15;
+	int tokMatch = m < 15 ? m : 15;
+	dest->add((char)(tokLit << 4 | tokMatch));
+	if (tokLit == 15) putLen(dest, numLits - 15);
+	int n = dest->num;
+	dest->setMaxUp(n + numLits);
+	memcpy(dest->items + n, lits, numLits);
+	dest->num = n + numLits;
+	if (!matchLen) return;
+	dest->add((char)(offset & 0xFF));
+	dest->add((char)(offset >> 8));
+	if (tokMatch == 15) putLen(dest, m - 15);
+}
+
+void lz_compress(list<char> *dest, char const *_src, int len) {
+	u8 const *src = (u8 const*)_src;
+	// Positions+1, so 0 means "nothing here yet"
+	int *table = (int*)calloc(1 << HASH_BITS, sizeof(int));
+	int anchor = 0, i = 0;
+	while (i + LZ_MIN_MATCH <= len) {
+		uint32_t h = hash4(src + i);
+		int cand = table[h] - 1;
+		table[h] = i + 1;
+		if (cand < 0 || i - cand > MAX_OFFSET || memcmp(src + cand, src + i, LZ_MIN_MATCH)) {
+			i++;
+			continue;
+		}
+		int matchLen = LZ_MIN_MATCH;
+		while (i + matchLen < len && src[cand + matchLen] == src[i + matchLen]) matchLen++;
+		putSequence(dest, src + anchor, i - anchor, i - cand, matchLen);
+		i += matchLen;
+		anchor = i;
+	}
+	// Whatever's left is literals, with no match after them
+	putSequence(dest, src + anchor, len - anchor, 0, 0);
+	free(table);
+}
+
+// Fails as soon as the length goes past `max` (what's left of the input / output),
+// so a long run of 255s can't overflow `*out`.
+static char getLen(u8 const *src, int len, int *ix, int *out, int max) {
+	while (1) {
+		if (*ix >= len) return 1;
+		int b = src[(*ix)++];
+		*out += b;
+		if (*out > max) return 1;
+		if (b != 255) return 0;
+	}
+}
+
+char lz_decompress(list<char> *dest, char const *_src, int len, int rawLen) {
+	u8 const *src = (u8 const*)_src;
+	if (len < 0 || rawLen < 0) return 1;
+	int start = dest->num;
+	dest->setMaxUp(start + rawLen);
+	u8 *out = (u8*)dest->items + start;
+	int o = 0, ix = 0;
+	while (1) {
+		if (ix >= len) return 1;
+		int token = src[ix++];
+		int numLits = token >> 4;
+		if (numLits == 15 && getLen(src, len, &ix, &numLits, len - ix)) return 1;
+		if (numLits < 0 || numLits > len - ix || numLits > rawLen - o) return 1;
+		memcpy(out + o, src + ix, numLits);
+		o += numLits;
+		ix += numLits;
+		if (ix == len) break; // Last sequence has no match
+		if (len - ix < 2) return 1;
+		int offset = src[ix] | src[ix+1] << 8;
+		ix += 2;
+		int matchLen = token & 15;
+		if (matchLen == 15 && getLen(src, len, &ix, &matchLen, rawLen - o - LZ_MIN_MATCH)) return 1;
+		matchLen += LZ_MIN_MATCH;
+		if (!offset || offset > o || matchLen < 0 || matchLen > rawLen - o) return 1;
+		// Byte-by-byte, since the match may overlap what it's producing
+		range(k, matchLen) out[o + k] = out[o + k - offset];
+		o += matchLen;
+	}
+	if (o != rawLen) return 1;
+	dest->num = start + rawLen;
+	return 0;
+}
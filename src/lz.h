@@ -0,0 +1,21 @@
+#pragma once
+
+#include "list.h"
+
+// Small LZ77-style byte compressor, for big one-off blobs like `/sync` state.
+// Format is a series of sequences, each:
+//   token byte: high nibble = literal count, low nibble = match length - LZ_MIN_MATCH
+//               (15 in either nibble means more bytes follow, each adding 0-255, until one isn't 255)
+//   literals
+//   2-byte little-endian match offset (back from the current output position), then match length bytes
+// The last sequence stops after its literals. No checksums or framing, that's up to the caller.
+
+#define LZ_MIN_MATCH 4
+// Most that `lz_compress` can turn `n` bytes into (all literals, plus the length bytes)
+#define LZ_BOUND(n) ((n) + (n)/255 + 16)
+
+// Appends compressed `src` to `dest`
+extern void lz_compress(list<char> *dest, char const *src, int len);
+// Appends decompressed `src` to `dest`, which must come out to exactly `rawLen` bytes.
+// Returns 1 if `src` is malformed.
+extern char lz_decompress(list<char> *dest, char const *src, int len, int rawLen);
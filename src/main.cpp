@@ -10,6 +10,7 @@
 #include <winsock2.h>
 #else
 #include <arpa/inet.h>
+#include <sys/prctl.h>
 #endif
 
 #include <glad/gl.h>
@@ -21,6 +22,7 @@
 #include "queue.h"
 #include "bloc.h"
 #include "mtx.h"
+#include "spsc.h"
 
 #include "config.h"
 #include "mypoll.h"
@@ -33,6 +35,13 @@
 #include "gamestate.h"
 #include "game_callbacks.h"
 #include "graphics_callbacks.h"
+#include "main_graphics.h"
+#include "bench.h"
+#include "spsc_test.h"
+#include "glcount.h"
+#include "lz.h"
+#include "relay.h"
+#include "metrics.h"
 
 char globalRunning = 1;
 int myPlayer;
@@ -48,21 +57,30 @@ static char textSendInd = 0;
 
 struct {
 	int width, height;
-	char changed;
+	// Set under `renderMutex`, but checked without it
+	std::atomic<char> changed;
 } screenSize;
+// Only guards `screenSize` now
+static mtx_t renderMutex = MTX_INIT_EXPR;
 
 // For rendering that isn't frame-locked.
-static struct {
-	gamestate *pickup, *dropoff;
+// The game thread is the producer and the render thread is the consumer (see `triple` in spsc.h).
+struct renderSlot {
+	renderSnapshot *rs;
 	long nanos;
 	int phantomFrames;
-} renderData = {};
-static mtx_t renderMutex = MTX_INIT_EXPR;
-static gamestate *renderedState = NULL;
+};
+static triple<renderSlot> renderSlots;
+static renderSnapshot *renderedSnapshot = NULL;
 static long renderStartNanos = 0;
 static char manualGlFinish = 1;
 int renderPhantomFrames = 0;
-list<ggc_msg> *msgs_game, *msgs_gfx, *msgs_exchange;
+std::atomic<int> renderFramesOverwritten(0);
+int renderFramesRepeated = 0;
+list<ggc_msg> *msgs_game, *msgs_gfx;
+// Messages go through their own ring (rather than riding along with a snapshot),
+// since unlike snapshots it's not okay to drop them.
+static spsc<ggc_msg, 1024> ggcRing;
 
 static char chatBuffer[TEXT_BUF_LEN];
 
@@ -89,13 +107,62 @@ static int performanceFrames = 0, performanceIters = 0;
 #define SERVER_MIA 60
 #define SERVER_WAY_AHEAD 5
 
+// Spectators (`--spectate`) don't take a player slot or send anything.
+// They connect to the server's spectator port, which is one past the player port,
+// and show finalized frames this far behind the newest one (the camera follows player 0).
+#define SPECTATE_DELAY 3
+static char spectating = 0;
+// Hosting (`--listen`) means we run the relay ourselves instead of connecting to a server
+static char listening = 0;
+
 static int fasterFrames = 0;
+
+// Adaptive lead: we time how long before the server's broadcast of a frame our inputs for it went out,
+// and pace ourselves to keep that just above what it takes to get them there: the RTT, some allowance
+// for jitter, and a bias that goes up whenever we're actually late and slowly decays otherwise.
+// Every frame of lead is a frame the phantom re-simulates, so less is better.
+#define LEAD_MARGIN_NANOS 5'000'000
+#define LEAD_LATE_BUMP (STEP_NANOS/4)
+#define LEAD_BIAS_MAX (STEP_NANOS*4)
+#define LEAD_BIAS_DECAY 20'000 // per on-time frame
+#define LEAD_SMOOTHING 8
+static net2_frameTime sendTimes[NET2_TIMES];
+static long leadAvgNanos = 0;
+static long leadBiasNanos = 0;
+static long rollbackAvgCenti = 0;
+std::atomic<int> leadAvgMicros(0), leadTargetMicros(0), rollbackCenti(0);
 static time_t startSec;
 
+// Ticks sleep until an absolute deadline, but stop this far short of it and spin the rest,
+// since the kernel tends to wake us a little late (0 turns the spinning off).
+// How late we actually were goes in `tickLateHist`, for the overlay.
+#define TICK_SPIN_NANOS 200'000
+std::atomic<int> tickLateHist[TICK_LATE_BUCKETS];
+std::atomic<int> tickLateMaxMicros(0);
+
 #define BIN_CMD_SYNC 128
 #define BIN_CMD_LOAD 129
+// Whole-game state (`/sync`, `/load`) is compressed, then goes out as a series of these, one per frame,
+// so a multi-megabyte blob doesn't hold up everyone's inputs in one go.
+// Each is [BIN_CMD_CHUNK][flags][data...]. Concatenated, the data is
+// [BIN_CMD_SYNC or BIN_CMD_LOAD][4-byte raw length][lz-compressed state].
+#define BIN_CMD_CHUNK 130
+#define CHUNK_FIRST 1
+#define CHUNK_LAST 2
+// The server's usage pool is 4MB (refilling at 20KB/s), so bursts of these are fine
+#define CHUNK_SIZE (64*1024)
+// Anything claiming to decompress bigger than this is garbage.
+// Every peer buffers and decompresses every stream, so this is kept to what a real level needs.
+#define MAX_STREAM_LEN (32*1024*1024)
+// Likewise for what we'll buffer before decompressing: the header, plus the compressed data
+#define MAX_STREAM_COMPRESSED (5 + LZ_BOUND(MAX_STREAM_LEN))
 static queue<list<char>> outboundData;
 static list<char> syncData; // Temporary buffer for savegame data, for "/sync" command
+// Outgoing chunked state, and how much of it has been sent
+static list<char> streamOut;
+static int streamOutPos = 0;
+// Per player, chunks received so far (empty if no stream in progress)
+static list<list<char>> streamIn;
 static int syncNeeded = 0;
 mtx_t sharedInputsMutex = MTX_INIT_EXPR;
 static char isLoader = 0;
@@ -109,6 +176,75 @@ static long nowNanos() {
 	return BILLION * (now.tv_sec - startSec) + now.tv_nsec;
 }
 
+static void recordLateness(long nanos) {
+	int micros = nanos / 1000;
+	int bucket = 0;
+	while (bucket < TICK_LATE_BUCKETS-1 && micros >= (1 << bucket)) bucket++;
+	tickLateHist[bucket].fetch_add(1, std::memory_order::relaxed);
+	if (micros > tickLateMaxMicros.load(std::memory_order::relaxed)) {
+		tickLateMaxMicros.store(micros, std::memory_order::relaxed);
+	}
+}
+
+// For whichever thread is calling `sleepUntil`. Linux lets timers fire up to 50us late by default to save power;
+// we'd rather they didn't.
+static void tightenTimerSlack() {
+#ifndef _WIN32
+	prctl(PR_SET_TIMERSLACK, 1);
+#endif
+}
+
+// Returns 0 without sleeping if `destNanos` has already passed
+static char sleepUntil(long destNanos) {
+	long now = nowNanos();
+	if (destNanos <= now) return 0;
+	long sleepTo = destNanos - TICK_SPIN_NANOS;
+	if (sleepTo > now) {
+#ifdef _WIN32
+		// Relative is all we've got. Being interrupted just means we go around again.
+		long left;
+		while ((left = sleepTo - nowNanos()) > 0) {
+			timespec t = {.tv_sec = 0, .tv_nsec = left};
+			nanosleep(&t, NULL);
+		}
+#else
+		// `clock_nanosleep` doesn't do CLOCK_MONOTONIC_RAW, so we aim for the same moment on CLOCK_MONOTONIC.
+		// The two only drift apart by NTP's tiny adjustments, which don't matter over one tick.
+		timespec mono;
+		clock_gettime(CLOCK_MONOTONIC, &mono);
+		long monoNanos = BILLION * mono.tv_sec + mono.tv_nsec + (sleepTo - now);
+		timespec t = {.tv_sec = monoNanos / BILLION, .tv_nsec = monoNanos % BILLION};
+		// Deadline is absolute, so an interrupted sleep just picks up where it left off
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR) {}
+#endif
+	}
+	while ((now = nowNanos()) < destNanos) {}
+	recordLateness(now - destNanos);
+	return 1;
+}
+
+static long leadTargetNanos() {
+	// On Windows we don't get an RTT, so the bias has to find the right spot on its own
+	long rtt = net2_rttMicros.load(std::memory_order::relaxed);
+	long jitter = net2_jitterMicros.load(std::memory_order::relaxed);
+	return 1000*(rtt + 4*jitter) + LEAD_MARGIN_NANOS + leadBiasNanos;
+}
+
+// Called (with `netMutex`) for each frame as it's finalized, along with what we sent for it
+static void leadSample(list<char> const *sent, list<list<char>> const *finalized, char *late) {
+	int32_t frame = ntohl(*(int32_t*)sent->items);
+	int ix = frame % NET2_TIMES;
+	if (sendTimes[ix].frame == frame && net2_recvTimes[ix].frame == frame) {
+		long sample = net2_recvTimes[ix].nanos - sendTimes[ix].nanos;
+		leadAvgNanos += (sample - leadAvgNanos) / LEAD_SMOOTHING;
+	}
+	// Dummy data here means nothing from us made it to the server in time for this frame
+	if (!(*finalized)[myPlayer].max) {
+		*late = 1;
+		metric_lateFrames++;
+	}
+}
+
 static void saveGame(const char *name) {
 	list<char> data;
 	data.init();
@@ -126,14 +262,26 @@ void mouseGrab(char grab) {
 	glfwSetInputMode(display, GLFW_CURSOR, grab ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
 }
 
+// Starts sending `data` out in chunks, replacing anything that was still going out
+static void queueStream(u8 kind, list<char> const *data) {
+	if (data->num > MAX_STREAM_LEN) {
+		printf("State is %d bytes, which is more than anybody will accept (%d), not sending it\n", data->num, MAX_STREAM_LEN);
+		return;
+	}
+	streamOut.num = 0;
+	streamOut.add(kind);
+	streamOut.setMaxUp(5);
+	*(int32_t*)(streamOut.items + 1) = htonl(data->num);
+	streamOut.num = 5;
+	lz_compress(&streamOut, data->items, data->num);
+	streamOutPos = 0;
+	printf(QUIET_LINE("Sending state: %d bytes, %d compressed (%d frames)"), data->num, streamOut.num, (streamOut.num + CHUNK_SIZE - 1) / CHUNK_SIZE);
+}
+
 static void serializeControls(int32_t frame, list<char> *_out) {
 	list<char> &out = *_out;
 
-	u8 inputSize = getInputsSize();
-	int firstBlock = inputSize + 6; // 4 frame + 1 size + ? input data + 1 cmd count
-
-	out.setMaxUp(firstBlock);
-	out.num = firstBlock;
+	out.setMaxUp(getInputsSize() + 6);
 
 	// The server needs to know some things like frame index
 	// and where commands start/end so it can uphold its end
@@ -142,8 +290,10 @@ static void serializeControls(int32_t frame, list<char> *_out) {
 	// "input data" section is irrelevant to it, however, so
 	// we just use a byte to describe that section's length.
 	*(int32_t*)out.items = htonl(frame);
+	u8 inputSize = serializeInputs(&out[5]);
 	out[4] = inputSize;
-	serializeInputs(&out[5]);
+	int firstBlock = inputSize + 6; // 4 frame + 1 size + ? input data + 1 cmd count
+	out.num = firstBlock;
 
 	// out[firstBlock-1] is the number of commands, populate that at the end
 	u8 numCmds = 0;
@@ -151,14 +301,22 @@ static void serializeControls(int32_t frame, list<char> *_out) {
 	// Maybe a hook for other commands to be inserted here,
 	// like `doReload` would use.
 
-	if (syncData.num) {
-		out.setMaxUp(out.num + 4 + syncData.num);
-		*(int32_t*)(out.items + out.num) = htonl(syncData.num);
-		out.num += 4;
-		// First byte of syncData should identify to clients what kind of command it is.
+	if (streamOutPos < streamOut.num) {
+		int len = streamOut.num - streamOutPos;
+		if (len > CHUNK_SIZE) len = CHUNK_SIZE;
+		char flags = 0;
+		if (!streamOutPos) flags |= CHUNK_FIRST;
+		if (streamOutPos + len == streamOut.num) flags |= CHUNK_LAST;
+		int n = out.num;
+		out.setMaxUp(n + 6 + len);
+		// First byte of the cmd identifies to clients what kind of command it is.
 		// Server doesn't care about this though, just needs length + data for the cmd.
-		out.addAll(&syncData);
-		syncData.num = 0;
+		*(int32_t*)(out.items + n) = htonl(len + 2);
+		out[n + 4] = (char)BIN_CMD_CHUNK;
+		out[n + 5] = flags;
+		memcpy(out.items + n + 6, streamOut.items + streamOutPos, len);
+		out.num = n + 6 + len;
+		streamOutPos += len;
 		numCmds++;
 	}
 	while (outboundTextQueue.size()) {
@@ -184,19 +342,14 @@ static void serializeControls(int32_t frame, list<char> *_out) {
 		} else if (isCmd(text, "/load")) {
 			const char *file = "savegame";
 			if (text[5]) file = text + 6;
-			int initial = out.num;
-			// We'll record the size here later
-			out.setMaxUp(out.num += 4);
-
-			out.add((char)BIN_CMD_LOAD);
-			if (readFile(file, &out)) {
-				// If reading the file failed, don't send anything out at all
-				out.num = initial;
-			} else {
+			list<char> data;
+			data.init();
+			// If reading the file failed, don't send anything out at all
+			if (!readFile(file, &data)) {
 				printf("Loading game from %s\n", file);
-				*(int32_t*)(out.items + initial) = htonl(out.num - initial - 4);
-				numCmds++;
+				queueStream(BIN_CMD_LOAD, &data);
 			}
+			data.destroy();
 		} else if (isCmd(text, "/loader")) {
 			int32_t x;
 			const char *c = text + 7;
@@ -226,10 +379,12 @@ static void serializeControls(int32_t frame, list<char> *_out) {
 }
 
 static void updateResolution() {
-	if (screenSize.changed) {
-		screenSize.changed = 0;
-		setDisplaySize(screenSize.width, screenSize.height);
-	}
+	// Cheap check first, so we aren't locking every frame
+	if (!screenSize.changed.load(std::memory_order::acquire)) return;
+	mtx_lock(renderMutex);
+	screenSize.changed.store(0, std::memory_order::relaxed);
+	setDisplaySize(screenSize.width, screenSize.height);
+	mtx_unlock(renderMutex);
 }
 
 static void handleSharedInputs(int outboundFrame) {
@@ -242,7 +397,11 @@ static void handleSharedInputs(int outboundFrame) {
 
 	mtx_unlock(sharedInputsMutex);
 
-	sendData(out->items, out->num);
+	// net2 stamps frames with the raw clock, without our `startSec` offset
+	sendTimes[outboundFrame % NET2_TIMES] = {.frame = outboundFrame, .nanos = nowNanos() + BILLION*startSec};
+
+	if (listening) relay_hostSend(out->items, out->num);
+	else sendData(out->items, out->num);
 }
 
 static void ensurePrefsSent() {
@@ -276,39 +435,88 @@ static void processLoopbackCommand() {
 		saveGame(name);
 	} else if (isCmd(c, "/sync")) {
 		syncData.num = 0;
-		syncData.add(BIN_CMD_SYNC);
 		serialize(rootState, &syncData);
+		queueStream(BIN_CMD_SYNC, &syncData);
+		syncData.num = 0;
 	} else if (!customLoopbackCommand(rootState, c)) {
 		printf("Unknown loopback command: %s\n", c);
 	}
 }
 
-static void processCmd(gamestate *gs, player *p, char const *data, int chars, char isMe, char isReal) {
-	if (chars && (*(unsigned char*)data == BIN_CMD_LOAD || *(unsigned char*)data == BIN_CMD_SYNC)) {
-		if (!isReal) return;
-		char isSync = *(unsigned char*)data == BIN_CMD_SYNC;
-
-		if (isSync) {
-			if (syncNeeded > MAX_AHEAD) {
-				syncNeeded = 0;
-				// Probably already `isLoader == isMe`, but maybe not.
-				// (e.g. if the loader left and someone else did the sync)
-				isLoader = isMe;
-			}
-			// After we've been synced in, if there are no other auto-syncs on the horizon,
-			// that's a good time to send our stuff and be fairly sure it won't be lost.
-			if (!syncNeeded) ensurePrefsSent();
-		} else {
+static void loadState(char isSync, char isMe, list<char> *data) {
+	if (isSync) {
+		if (syncNeeded > MAX_AHEAD) {
+			syncNeeded = 0;
+			// Probably already `isLoader == isMe`, but maybe not.
+			// (e.g. if the loader left and someone else did the sync)
 			isLoader = isMe;
 		}
+		// After we've been synced in, if there are no other auto-syncs on the horizon,
+		// that's a good time to send our stuff and be fairly sure it won't be lost.
+		if (!syncNeeded) ensurePrefsSent();
+	} else {
+		isLoader = isMe;
+	}
 
-		prepareGamestateForLoad(rootState, isSync);
+	prepareGamestateForLoad(rootState, isSync);
+	deserialize(rootState, data, isSync);
+}
 
-		// Casting away the `const` here is probably bad.
-		// Whatever, I'm throwing away safety for readability in the serialization code
-		list<char> fakeList = {.items=(char*)(data+1), .num = chars-1, .max = chars-1};
+static void receiveChunk(int player, char flags, char const *data, int len, char isMe) {
+	while (streamIn.num <= player) streamIn.add().init();
+	list<char> &buf = streamIn[player];
+	if (flags & CHUNK_FIRST) {
+		buf.num = 0;
+	} else if (!buf.num) {
+		// We showed up partway through somebody's stream, nothing to do with it
+		return;
+	}
+	int n = buf.num;
+	if (len > MAX_STREAM_COMPRESSED - n) {
+		puts("Got an oversized state stream, ignoring it");
+		buf.setMax(CHUNK_SIZE);
+		buf.num = 0;
+		return;
+	}
+	buf.setMaxUp(n + len);
+	memcpy(buf.items + n, data, len);
+	buf.num = n + len;
+
+	if ((flags & CHUNK_FIRST) && buf.num && (u8)buf[0] == BIN_CMD_SYNC && syncNeeded) {
+		// A sync is on its way, and it may take a while to arrive. Park `syncNeeded` where it won't
+		// trigger any more auto-syncs, but finishing the sync still clears it.
+		// If this stream never finishes (sender left?), the next `/syncme` starts things over.
+		syncNeeded = 2*MAX_AHEAD + 1;
+	}
+	if (!(flags & CHUNK_LAST)) return;
+
+	char bad = 1;
+	if (buf.num >= 5) {
+		u8 kind = buf[0];
+		int32_t rawLen = ntohl(*(int32_t*)(buf.items + 1));
+		list<char> raw;
+		raw.init();
+		if (
+			(kind == BIN_CMD_SYNC || kind == BIN_CMD_LOAD)
+			&& rawLen >= 0 && rawLen <= MAX_STREAM_LEN
+			&& !lz_decompress(&raw, buf.items + 5, buf.num - 5, rawLen)
+		) {
+			loadState(kind == BIN_CMD_SYNC, isMe, &raw);
+			bad = 0;
+		}
+		raw.destroy();
+	}
+	if (bad) puts("Got a bad state stream, ignoring it");
+	// Could be megabytes, don't hang onto all that
+	buf.setMax(CHUNK_SIZE);
+	buf.num = 0;
+}
 
-		deserialize(rootState, &fakeList, isSync);
+static void processCmd(gamestate *gs, player *p, char const *data, int chars, char isMe, char isReal) {
+	if (chars && *(unsigned char*)data == BIN_CMD_CHUNK) {
+		// Only the real state gets loaded, and streams are tracked outside of it
+		if (!isReal || chars < 2) return;
+		receiveChunk(p - gs->players.items, data[1], data + 2, chars - 2, isMe);
 		return;
 	}
 	if (processBinCmd(gs, p, data, chars, isMe, isReal)) return;
@@ -318,6 +526,10 @@ static void processCmd(gamestate *gs, player *p, char const *data, int chars, ch
 		tmpBuffer[chars] = '\0';
 		if (isCmd(tmpBuffer, "/syncme")) {
 			if (isReal && !isMe) syncNeeded = 1;
+		} else if (isCmd(tmpBuffer, "/spectator")) {
+			// The server tacks this onto somebody's message when a spectator joins.
+			// It's not really from `p`, so it doesn't matter if that's us.
+			if (isReal) syncNeeded = 1;
 		} else if (!processTxtCmd(gs, p, tmpBuffer, isMe, isReal)) {
 			memcpy(chatBuffer, tmpBuffer, chars+1);
 		}
@@ -337,7 +549,7 @@ static void doWholeStep(gamestate *state, list<list<char>> const *_inputData, ch
 	}
 
 	range(i, numPlayers) {
-		char isMe = i == myPlayer;
+		char isMe = !spectating && i == myPlayer;
 		list<char> const &data = inputData[i];
 		if (!data.num) {
 			puts("0-length player data, net2.cpp should prevent this!");
@@ -388,6 +600,21 @@ static void insertOutbound(list<char> *dest, list<char> *src) {
 	dest->items = src->items + 4;
 }
 
+// Hands `gs` (plus any pending messages) over to the render thread
+static void publishSnapshot(gamestate *gs, int phantomFrames) {
+	auto &slot = renderSlots.slots[renderSlots.back];
+	fillRenderSnapshot(slot.rs, gs);
+	slot.nanos = nowNanos();
+	slot.phantomFrames = phantomFrames;
+
+	// Messages go out first, so they're visible by the time the snapshot is.
+	// If the ring is full (gfx thread badly behind?), the rest wait in order for next time.
+	ggcRing.pushSome(msgs_game);
+
+	// Render thread never got to the last one
+	if (renderSlots.publish()) renderFramesOverwritten.fetch_add(1, std::memory_order::relaxed);
+}
+
 static void* gameThreadFunc(void *startFramePtr) {
 	long performanceTotal = 0;
 	char catchupMode = 0;
@@ -405,24 +632,17 @@ static void* gameThreadFunc(void *startFramePtr) {
 	mtx_unlock(netMutex);
 
 	long destNanos = nowNanos() - STEP_NANOS*3; // Start out a bit behind
+	tightenTimerSlack();
 
 	while (globalRunning) {
-		long sleepNanos = destNanos - nowNanos();
-		if (sleepNanos > 999999999) {
+		long wakeNanos = destNanos;
+		if (wakeNanos - nowNanos() > 999999999) {
+			// No idea why this would ever come up. We wake up in a second and check again.
 			puts("WARN - Tried to wait for more than a second???");
-			// No idea why this would ever come up, but also it runs afoul of the spec to
-			// request an entire second or more in the tv_nsec field.
-			sleepNanos = 999999999;
-		}
-		char behindClock = 0;
-		if (sleepNanos > 0) {
-			timespec t;
-			t.tv_sec = 0;
-			t.tv_nsec = sleepNanos;
-			if (nanosleep(&t, NULL)) continue; // Something happened, we don't really care what, do it over again
-		} else {
-			behindClock = 1;
+			wakeNanos = nowNanos() + 999999999;
 		}
+		char behindClock = !sleepUntil(wakeNanos);
+		if (wakeNanos != destNanos) continue;
 
 		clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
 
@@ -447,6 +667,7 @@ static void* gameThreadFunc(void *startFramePtr) {
 				// This scenario is a little unlikely, as it means we've received data from at least one other client
 				// for a frame that we just sent our data for. Clients don't like sending their data earlier than necessary
 				// (or rather, they only simulate far enough ahead to get their data in on time).
+				metric_earlyFrames++;
 				list<char> *netInputs = frameData.peek(outboundSize).items;
 				range(i, playerDatas.num) {
 					// "dummy" (filler) netInputs have (max==0).
@@ -460,47 +681,15 @@ static void* gameThreadFunc(void *startFramePtr) {
 				}
 			}
 			doWholeStep(phantomState, &playerDatas, 0);
-
-			gamestate *disposeMe = NULL;
-
-			// Doing this outside the mutex probably doesn't matter much,
-			// but waiting for the lock could be a bit inconsistent,
-			// so this is marginally better I think
-			long now = nowNanos();
-			mtx_lock(renderMutex);
-			if (renderData.dropoff) {
-				disposeMe = renderData.dropoff;
-				renderData.dropoff = NULL;
-			} else if (renderData.pickup) {
-				disposeMe = renderData.pickup;
-			}
-			renderData.pickup = phantomState;
-			renderData.nanos = now;
-			renderData.phantomFrames = outboundSize;
-			// Not sure if I should just check this or assume always true?
-			if (msgs_game->num) {
-				// Shouldn't happen unless we outpace gfx thread somehow?
-				if (msgs_exchange->num) {
-					msgs_exchange->addAll(msgs_game);
-					msgs_game->num = 0;
-				} else {
-					list<ggc_msg> *swap = msgs_exchange;
-					msgs_exchange = msgs_game;
-					msgs_game = swap;
-				}
-			}
-			mtx_unlock(renderMutex);
-
-			if (disposeMe) {
-				cleanup(disposeMe);
-				free(disposeMe);
-			}
+			publishSnapshot(phantomState, outboundSize);
 		}
 
 		clock_gettime(CLOCK_MONOTONIC_RAW, &t3);
 
+		metric_backlog.store(finalizedFrames - 1, std::memory_order::relaxed);
 		// Now we can consider the prospect of re-simulating from the rootState
 		if (finalizedFrames > 1) {
+			char late = 0;
 			int toAdvance = finalizedFrames - 1;
 			int outboundSize = outboundData.size();
 			if (outboundSize < toAdvance) toAdvance = outboundSize; // Unlikely
@@ -529,36 +718,52 @@ static void* gameThreadFunc(void *startFramePtr) {
 				}
 				// An "official" step, all clients expect to agree on the state here
 				doWholeStep(rootState, &frameData.peek(i+1), 1);
+				leadSample(&outboundData.peek(i), &frameData.peek(i+1), &late);
 			}
 			frameData.multipop(toAdvance);
 			outboundData.multipop(toAdvance);
 			outboundSize -= toAdvance;
 			finalizedFrames -= toAdvance;
 
-			char clockOk = behindClock; // If we're behind the clock, then don't blame issues on the clock; we just need to catch up
+			// If we're behind the clock, then don't blame issues on the clock; we just need to catch up
+			char clockOk = behindClock || !late;
+			if (!clockOk) {
+				leadBiasNanos += LEAD_LATE_BUMP;
+				if (leadBiasNanos > LEAD_BIAS_MAX) leadBiasNanos = LEAD_BIAS_MAX;
+			} else {
+				leadBiasNanos -= LEAD_BIAS_DECAY * toAdvance;
+				if (leadBiasNanos < 0) leadBiasNanos = 0;
+			}
+			rollbackAvgCenti += (100*outboundSize - rollbackAvgCenti) / LEAD_SMOOTHING;
 			playerDatas.num = 0;
 			playerDatas.addAll(&frameData.peek(0));
+			// Nobody else holds onto the phantom state, so we can throw it out right away
+			cleanup(phantomState);
+			free(phantomState);
 			newPhantom(rootState);
 			int frameDataSize = frameData.size();
+			metric_resimFrames += outboundSize;
+			metric_rollbackLast.store(outboundSize, std::memory_order::relaxed);
+			if (outboundSize > metric_rollbackMax.load(std::memory_order::relaxed)) metric_rollbackMax.store(outboundSize, std::memory_order::relaxed);
 			range(outboundIx, outboundSize) {
 				insertOutbound(&playerDatas[myPlayer], &outboundData.peek(outboundIx));
 				if (outboundIx+1 < frameDataSize) {
 					list<char> *netInputs = frameData.peek(outboundIx+1).items;
 					range(i, playerDatas.num) {
-						if (netInputs[i].max) {
-							playerDatas[i] = netInputs[i];
-							// If the server has any input from us ahead of time, we're going fast enough.
-							if (i == myPlayer) clockOk = 1;
-						}
+						if (netInputs[i].max) playerDatas[i] = netInputs[i];
 					}
 				}
 				doWholeStep(phantomState, &playerDatas, 0);
 			}
-			if (!clockOk) fasterFrames = PENALTY_FRAMES;
+			if (!clockOk) {
+				fasterFrames = PENALTY_FRAMES;
+				metric_lateBatches++;
+			}
 		} else {
 			if (outboundData.size() >= SERVER_MIA) {
 				puts("Game thread: Server is way behind, going to sleep until we hear something");
 				asleep = 1;
+				metric_miaSleeps++;
 				while (globalRunning && finalizedFrames <= 1) {
 					mtx_wait(netCond, netMutex);
 				}
@@ -566,9 +771,8 @@ static void* gameThreadFunc(void *startFramePtr) {
 				puts("Game thread: Waking up");
 				destNanos = nowNanos();
 			}
-			// We still need to make a copy since the rendering stuff is probably working with
-			// the current phantomState.
-			newPhantom(phantomState);
+			// The render thread works from its own snapshot,
+			// so we just keep stepping the same phantomState.
 		}
 
 		if (fasterFrames) {
@@ -577,6 +781,7 @@ static void* gameThreadFunc(void *startFramePtr) {
 				if (!catchupMode) {
 					printf("Game thread: %d frames behind, entering catchup mode!\n", finalizedFrames-1);
 					catchupMode = 1;
+					metric_catchups++;
 				}
 				// Don't update destNanos.
 				// This means we'll try to run the next frame immediately.
@@ -590,9 +795,15 @@ static void* gameThreadFunc(void *startFramePtr) {
 				}
 				destNanos += FASTER_NANOS;
 			}
+		} else if (leadAvgNanos < leadTargetNanos()) {
+			// Our inputs are cutting it close, pull ahead a little
+			destNanos += FASTER_NANOS;
 		} else {
 			destNanos += STEP_NANOS;
 		}
+		leadAvgMicros.store(leadAvgNanos / 1000, std::memory_order::relaxed);
+		leadTargetMicros.store(leadTargetNanos() / 1000, std::memory_order::relaxed);
+		rollbackCenti.store(rollbackAvgCenti, std::memory_order::relaxed);
 
 		mtx_unlock(netMutex);
 
@@ -602,6 +813,10 @@ static void* gameThreadFunc(void *startFramePtr) {
 			update_nanos = BILLION * (t3.tv_sec - t2.tv_sec) + (t3.tv_nsec - t2.tv_nsec);
 			follow_nanos = BILLION * (t4.tv_sec - t3.tv_sec) + (t4.tv_nsec - t3.tv_nsec);
 			timekeeping(inputs_nanos, update_nanos, follow_nanos);
+			metric_inputsMicros.store(inputs_nanos / 1000, std::memory_order::relaxed);
+			metric_updateMicros.store(update_nanos / 1000, std::memory_order::relaxed);
+			metric_followMicros.store(follow_nanos / 1000, std::memory_order::relaxed);
+			metric_ticks++;
 			// TODO could probably move this into our timekeeping function
 			if (performanceFrames) {
 				performanceFrames--;
@@ -621,6 +836,56 @@ static void* gameThreadFunc(void *startFramePtr) {
 	return NULL;
 }
 
+// Game thread for spectators. We don't send anything, so there's no phantom and nothing to predict;
+// we just step `rootState` through finalized frames, a few frames behind whatever's arrived.
+// That delay soaks up network jitter the way a player's lead would.
+static void* spectatorThreadFunc(void *_arg) {
+	long destNanos = nowNanos();
+	char buffering = 1;
+	tightenTimerSlack();
+	while (globalRunning) {
+		sleepUntil(destNanos);
+
+		mtx_lock(netMutex);
+		// There's always one leftover finalized frame, hence the `- 1`s
+		if (finalizedFrames - 1 < (buffering ? SPECTATE_DELAY : 1)) {
+			// Ran dry (or haven't filled up yet), wait until we're back to the full delay.
+			// Nothing to draw in the meantime, the render thread keeps showing the last snapshot.
+			if (!buffering) {
+				buffering = 1;
+				metric_miaSleeps++;
+			}
+			asleep = 1;
+			while (globalRunning && finalizedFrames - 1 < SPECTATE_DELAY) {
+				mtx_wait(netCond, netMutex);
+			}
+			asleep = 0;
+			destNanos = nowNanos();
+		}
+		buffering = 0;
+		if (!globalRunning) {
+			mtx_unlock(netMutex);
+			break;
+		}
+		int backlog = finalizedFrames - 1;
+		metric_backlog.store(backlog, std::memory_order::relaxed);
+		metric_ticks++;
+		// Way behind (we stalled, or the host's machine did), skip the wait and just get back to the usual delay.
+		// Otherwise it's one frame per step, a little faster if there's more than we want.
+		int toAdvance = backlog > SPECTATE_DELAY + MAX_AHEAD ? backlog - SPECTATE_DELAY : 1;
+		if (toAdvance > 1) metric_catchups++;
+		range(i, toAdvance) doWholeStep(rootState, &frameData.peek(i+1), 1);
+		frameData.multipop(toAdvance);
+		finalizedFrames -= toAdvance;
+		backlog -= toAdvance;
+		mtx_unlock(netMutex);
+
+		publishSnapshot(rootState, 0);
+		destNanos += backlog > SPECTATE_DELAY ? FASTER_NANOS : STEP_NANOS;
+	}
+	return NULL;
+}
+
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
 	// Most keypresses don't do their usual function if we're
 	// typing. Key releases are fine though! This approach is
@@ -685,29 +950,23 @@ static void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 	mtx_lock(renderMutex);
 	screenSize.width = width;
 	screenSize.height = height;
-	screenSize.changed = 1;
+	screenSize.changed.store(1, std::memory_order::release);
 	mtx_unlock(renderMutex);
 }
 
 static void checkRenderData() {
-	mtx_lock(renderMutex);
-	if (renderData.pickup) {
-		renderData.dropoff = renderedState;
-		renderedState = renderData.pickup;
-		renderData.pickup = NULL;
-		renderStartNanos = renderData.nanos;
-		renderPhantomFrames = renderData.phantomFrames;
-	}
-	if (msgs_exchange->num) {
-		// It's assumed that `draw` empties the list of
-		// messages every time, which means "our" list
-		// will always be empty here.
-		list<ggc_msg> *swap = msgs_exchange;
-		msgs_exchange = msgs_gfx;
-		msgs_gfx = swap;
+	if (renderSlots.take()) {
+		auto &slot = renderSlots.slots[renderSlots.front];
+		renderedSnapshot = slot.rs;
+		renderStartNanos = slot.nanos;
+		renderPhantomFrames = slot.phantomFrames;
+	} else {
+		renderFramesRepeated++;
 	}
+	// `draw` empties `msgs_gfx` every time, so we're just appending to an empty list here
+	ggc_msg m;
+	while (ggcRing.pop(&m)) msgs_gfx->add(m);
 	updateResolution();
-	mtx_unlock(renderMutex);
 }
 
 static void* renderThreadFunc(void *_arg) {
@@ -726,15 +985,16 @@ static void* renderThreadFunc(void *_arg) {
 		float interpRatio = (float)(time0 - renderStartNanos) / STEP_NANOS;
 		if (interpRatio > 1.1) interpRatio = 1.1; // Ideally it would be somewhere in (0, 1]
 
-		// Computation of `p` should be safe, even the initial `renderedState`
+		// Computation of `p` should be safe, even the initial `renderedSnapshot`
 		// is populated after we know the number of players in the game.
-		draw(renderedState, interpRatio, drawingNanos, totalNanos);
+		draw(renderedSnapshot, interpRatio, drawingNanos, totalNanos);
 		long time1 = nowNanos();
 
 		glfwSwapBuffers(display);
 		if (manualGlFinish) {
 			glFinish();
 		}
+		glcount_frame();
 		long time2 = nowNanos();
 
 		drawingNanos = time1-time0;
@@ -774,6 +1034,23 @@ static void* inputThreadFunc(void *_arg) {
 	return NULL;
 }
 
+#ifndef _WIN32
+// Stand-in for the input + render threads when there's no window.
+// The player just stands there, which is fine since what we're after is the netcode stats.
+static void headlessLoop(double seconds) {
+	timespec t;
+	t.tv_sec = 0;
+	t.tv_nsec = 10'000'000;
+	long endNanos = nowNanos() + (long)(seconds * BILLION);
+	while (globalRunning && nowNanos() < endNanos) {
+		nanosleep(&t, NULL);
+		// Nobody's drawing, but these still have to be drained (and freed)
+		ggc_msg m;
+		while (ggcRing.pop(&m)) ggcDestroy(&m);
+	}
+}
+#endif
+
 static char waitForThread(pthread_t thread) {
 #ifdef _WIN32
 	// Sorry Windows, you get less-nice thread joining
@@ -821,30 +1098,72 @@ static void cleanupThread(pthread_t thread, char const * const descr) {
 }
 
 int main(int argc, char **argv) {
-	printf(QUIET_LINE("init GLFW..."));
-	if (!glfwInit()) {
-		fputs("Couldn't init GLFW\n", stderr);
-		return 1;
-	}
-	printf(QUIET_LINE("init window..."));
-	display = glfwCreateWindow(1000, 700, WINDOW_TITLE, NULL, NULL);
-	if (!display) {
-		fputs("Couldn't create our display\n", stderr);
-		return 1;
+#ifndef _WIN32
+	// Benchmark mode doesn't want a window (or a server), it does its own setup
+	if (argc > 1 && !strcmp(argv[1], "--bench")) return bench_main(argc-2, argv+2);
+	if (argc > 1 && !strcmp(argv[1], "--spsc-test")) return spsc_test(argc-2, argv+2);
+#endif
+	// Headless mode is a normal client minus the window, for load-testing the netcode:
+	//   ./game --headless <seconds> [host] [port]
+	// It plays (standing still) for that long, then prints stats and exits.
+	double headlessSecs = 0;
+#ifndef _WIN32
+	if (argc > 1 && !strcmp(argv[1], "--headless")) {
+		if (argc < 3 || (headlessSecs = atof(argv[2])) <= 0) {
+			puts("Usage: --headless <seconds> [host] [port]");
+			return 1;
+		}
+		// Drop the two args, keeping the program name in front
+		argv[2] = argv[0];
+		argv += 2;
+		argc -= 2;
 	}
-	glfwMakeContextCurrent(display);
-	int version = gladLoadGL(glfwGetProcAddress);
-	if (version == 0) {
-		puts("Failed to initialize OpenGL context");
-		return 1;
+#endif
+	if (argc > 1 && !strcmp(argv[1], "--spectate")) {
+		spectating = 1;
+		argv[1] = argv[0];
+		argv++;
+		argc--;
+	} else if (argc > 1 && !strcmp(argv[1], "--listen")) {
+		listening = 1;
+		argv[1] = argv[0];
+		argv++;
+		argc--;
 	}
-	printf(QUIET_LINE("Loaded OpenGL %d.%d"), GLAD_VERSION_MAJOR(version), GLAD_VERSION_MINOR(version));
-
+#ifndef _WIN32
+	if (headlessSecs) {
+		if (bench_initEgl()) return 1;
+		setDisplaySize(1000, 700);
+	} else
+#endif
 	{
-		// Framebuffer size is not guaranteed to be equal to window size
-		int fbWidth, fbHeight;
-		glfwGetFramebufferSize(display, &fbWidth, &fbHeight);
-		setDisplaySize(fbWidth, fbHeight);
+		printf(QUIET_LINE("init GLFW..."));
+		if (!glfwInit()) {
+			fputs("Couldn't init GLFW\n", stderr);
+			return 1;
+		}
+		printf(QUIET_LINE("init window..."));
+		display = glfwCreateWindow(1000, 700, WINDOW_TITLE, NULL, NULL);
+		if (!display) {
+			fputs("Couldn't create our display\n", stderr);
+			return 1;
+		}
+		glfwMakeContextCurrent(display);
+		int version = gladLoadGL(glfwGetProcAddress);
+		if (version == 0) {
+			puts("Failed to initialize OpenGL context");
+			return 1;
+		}
+		printf(QUIET_LINE("Loaded OpenGL %d.%d"), GLAD_VERSION_MAJOR(version), GLAD_VERSION_MINOR(version));
+		// Cheap enough to always have on, and the stats overlay wants it
+		glcount_install();
+
+		{
+			// Framebuffer size is not guaranteed to be equal to window size
+			int fbWidth, fbHeight;
+			glfwGetFramebufferSize(display, &fbWidth, &fbHeight);
+			setDisplaySize(fbWidth, fbHeight);
+		}
 	}
 
 #ifdef _WIN32
@@ -862,17 +1181,20 @@ int main(int argc, char **argv) {
 	msgs_game->init();
 	msgs_gfx = new list<ggc_msg>();
 	msgs_gfx->init();
-	msgs_exchange = new list<ggc_msg>();
-	msgs_exchange->init();
+	ggcRing.init();
 	// GLFW context is still bound to the thread here because `game_init`
 	// is expected to init GL stuff (plus other stuff).
 	game_init();
-	glfwMakeContextCurrent(NULL); // Give up control so other thread can take it
+	// Give up control so other thread can take it.
+	// Headless has no render thread, so it just keeps the context.
+	if (!headlessSecs) glfwMakeContextCurrent(NULL);
 	printf(QUIET_LINE("GL + custom setup complete."));
 
 	outboundTextQueue.init();
 	outboundData.init();
 	syncData.init();
+	streamOut.init();
+	streamIn.init();
 	file_init();
 	config_init(); // Previously "config" depended on "file", but it does not anymore.
 
@@ -880,6 +1202,8 @@ int main(int argc, char **argv) {
 	// Compared to `game_init()`, we don't have the GL context any more,
 	// but we do have config loaded (and working dir is `data/` now).
 	printf(QUIET_LINE("init more custom..."));
+	// Several headless clients on one machine shouldn't all be opening the UI
+	if (headlessSecs) cfg_no_ui.set("y");
 	rootState = game_init2();
 	printf(QUIET_LINE("more custom complete."));
 
@@ -888,7 +1212,18 @@ int main(int argc, char **argv) {
 		printf("At most 2 args expected, got %d\n", argc-1);
 		return 1;
 	}
-	if (argc > 1) {
+	if (listening) {
+		// We're the host, so it's just the port
+		if (argc > 2) {
+			printf("At most 1 arg expected with --listen, got %d\n", argc-1);
+			return 1;
+		}
+		host = NULL;
+		if (argc > 1) {
+			port = argv[1];
+			portSrc = "program argument";
+		}
+	} else if (argc > 1) {
 		host = argv[1];
 		hostSrc = "program argument";
 		if (argc > 2) {
@@ -914,47 +1249,91 @@ int main(int argc, char **argv) {
 	}
 
 	// Other general game setup, including networking
-	printf(QUIET_LINE("Using host '%s' (%s) and port '%s' (%s)"), host, hostSrc, port, portSrc);
-	// initSocket has its own progress logging
-	if (initSocket(host, port)) return 1;
-	printf(QUIET_LINE("Awaiting setup info..."));
-	char initNetData[7];
-	if (readData(initNetData, 7)) {
-		puts("Error, aborting!");
-		return 1;
-	}
-	if (initNetData[0] != (char)MAGIC_FIRST_BYTE) {
-		printf(
-			"Server initial byte was 0x%hhX, expected 0x%hhX. Is the server on an incompatible version?\n",
-			initNetData[0],
-			MAGIC_FIRST_BYTE
-		);
-		return 1;
+	int numPlayers;
+	int32_t startFrame;
+	if (listening) {
+		printf(QUIET_LINE("Hosting on port '%s' (%s)"), port, portSrc);
+		if (relay_init(port)) return 1;
+		// Same as a fresh server would tell us
+		myPlayer = 0;
+		numPlayers = 1;
+		startFrame = 0;
+	} else {
+		printf(QUIET_LINE("Using host '%s' (%s) and port '%s' (%s)"), host, hostSrc, port, portSrc);
+		char const *connectPort = port;
+		char spectatePort[12];
+		if (spectating) {
+			snprintf(spectatePort, sizeof(spectatePort), "%d", atoi(port) + 1);
+			connectPort = spectatePort;
+			printf(QUIET_LINE("Spectating, so actually using port %s"), connectPort);
+		}
+		// initSocket has its own progress logging
+		if (initSocket(host, connectPort)) return 1;
+		printf(QUIET_LINE("Awaiting setup info..."));
+		char initNetData[7];
+		if (readData(initNetData, 7)) {
+			puts("Error, aborting!");
+			return 1;
+		}
+		if (initNetData[0] != (char)MAGIC_FIRST_BYTE) {
+			printf(
+				"Server initial byte was 0x%hhX, expected 0x%hhX. Is the server on an incompatible version?\n",
+				initNetData[0],
+				MAGIC_FIRST_BYTE
+			);
+			return 1;
+		}
+		numPlayers = initNetData[2];
+		startFrame = ntohl(*(int32_t*)(initNetData+3));
+		// Server says 255 for spectators
+		if (spectating != ((u8)initNetData[1] == 255)) {
+			puts(spectating ? "Server gave us a player slot, is that the spectator port?" : "Server thinks we're a spectator, is that the player port?");
+			return 1;
+		}
+		if (spectating) {
+			if (!numPlayers) {
+				puts("Nobody to spectate!");
+				return 1;
+			}
+			// Only matters for the camera
+			myPlayer = 0;
+			printf(QUIET_LINE("Done, spectating %d players"), numPlayers);
+		} else {
+			myPlayer = initNetData[1];
+			printf(QUIET_LINE("Done, I am client #%d out of %d"), myPlayer, numPlayers);
+		}
+		// Connection was at least mostly successful,
+		// record the `host` and `port` that we used.
+		cfg_host.set(host);
+		cfg_port.set(port);
 	}
-	myPlayer = initNetData[1];
-	int numPlayers = initNetData[2];
-	int32_t startFrame = ntohl(*(int32_t*)(initNetData+3));
-	printf(QUIET_LINE("Done, I am client #%d out of %d"), myPlayer, numPlayers);
 	setupPlayers(rootState, numPlayers);
-	isLoader = (numPlayers == 1);
-	// Connection was at least mostly successful,
-	// record the `host` and `port` that we used.
-	cfg_host.set(host);
-	cfg_port.set(port);
+	isLoader = (numPlayers == 1 && !spectating);
 
 	net2_init(numPlayers, startFrame);
 	watch_init();
-	mypoll_init(); // Uses fd's from "net" and "watch", so has to wait for them to init
-
-	// init phantomState
-	newPhantom(rootState);
-	renderedState = dup(rootState); // Give us something to render, so we can skip null checks
+	mypoll_init(listening); // Uses fd's from "net" and "watch", so has to wait for them to init
+	// The relay feeds our frames straight to net2, so it has to wait for that
+	if (listening) relay_start();
+
+	// init phantomState. Spectators only ever look at `rootState`.
+	if (!spectating) newPhantom(rootState);
+	// Give us something to render, so we can skip null checks
+	range(i, 3) renderSlots.slots[i].rs = mkRenderSnapshot();
+	renderSlots.init();
+	renderedSnapshot = renderSlots.slots[renderSlots.front].rs;
+	fillRenderSnapshot(renderedSnapshot, rootState);
 
 	// Setup text buffers.
 	// We make it so the player automatically sends the "syncme" command on their first frame
 	main_textBuffer[TEXT_BUF_LEN-1] = '\0';
-	strcpy(outboundTextQueue.add().items, "/syncme");
-	if (isLoader) ensurePrefsSent();
+	if (spectating) {
+		// Spectators can't send anything. The server asks the players for a sync on our behalf.
+		prefsSent = 1;
+	} else {
+		strcpy(outboundTextQueue.add().items, "/syncme");
+		if (isLoader) ensurePrefsSent();
+	}
 
 	chatBuffer[0] = chatBuffer[TEXT_BUF_LEN-1] = '\0';
 	loopbackCommandBuffer[0] = '\0';
@@ -971,7 +1350,7 @@ int main(int argc, char **argv) {
 	pthread_t pollThread;
 	pthread_t renderThread;
 	{
-		int ret = pthread_create(&gameThread, NULL, gameThreadFunc, &startFrame);
+		int ret = pthread_create(&gameThread, NULL, spectating ? spectatorThreadFunc : gameThreadFunc, &startFrame);
 		if (ret) {
 			printf("pthread_create returned %d for gameThread\n", ret);
 			return 1;
@@ -982,7 +1361,7 @@ int main(int argc, char **argv) {
 			pthread_cancel(gameThread); // No idea if this works, this is a failure case anyway
 			return 1;
 		}
-		ret = pthread_create(&renderThread, NULL, renderThreadFunc, NULL);
+		if (!headlessSecs) ret = pthread_create(&renderThread, NULL, renderThreadFunc, NULL);
 		if (ret) {
 			printf("pthread_create returned %d for renderThread\n", ret);
 			pthread_cancel(gameThread); // No idea if this works, this is a failure case anyway
@@ -991,6 +1370,10 @@ int main(int argc, char **argv) {
 		}
 	}
 	// Main thread lives in here until the program exits
+#ifndef _WIN32
+	if (headlessSecs) headlessLoop(headlessSecs);
+	else
+#endif
 	inputThreadFunc(NULL);
 
 	puts("Beginning shutdown.");
@@ -1002,25 +1385,40 @@ int main(int argc, char **argv) {
 	mtx_signal(netCond);
 	mtx_unlock(netMutex);
 
-	printf(QUIET_LINE("Writing config file..."));
-	config_write();
-	printf(QUIET_LINE("Done."));
+	// Headless clients would all be fighting over the one config file, and they didn't change anything anyway
+	if (!headlessSecs) {
+		printf(QUIET_LINE("Writing config file..."));
+		config_write();
+		printf(QUIET_LINE("Done."));
+	}
 	printf(QUIET_LINE("Beginning cleanup."));
 	cleanupThread(pollThread, "poll");
 	cleanupThread(gameThread, "game");
-	cleanupThread(renderThread, "render");
+	// Relay thread also calls into net2, so it's done before that goes away
+	if (listening) relay_destroy();
+	if (!headlessSecs) cleanupThread(renderThread, "render");
+	if (headlessSecs) {
+		// One line, so a harness can pick it out of everything else we print
+		printf(
+			"HEADLESS client=%d secs=%.1f resim=%ld resim_per_sec=%.1f catchups=%d mia_sleeps=%d late_batches=%d lead_ms=%.1f wake_max_us=%d\n",
+			spectating ? -1 : myPlayer, headlessSecs, metric_resimFrames.load(), metric_resimFrames.load() / headlessSecs,
+			metric_catchups.load(), metric_miaSleeps.load(), metric_lateBatches.load(), leadAvgNanos / 1e6,
+			tickLateMaxMicros.load(std::memory_order::relaxed)
+		);
+	}
 	closeSocket();
 	printf(QUIET_LINE("Cleaning up game objects..."));
 	cleanup(rootState);
 	free(rootState);
-	cleanup(phantomState);
-	free(phantomState);
-	cleanup(renderedState);
-	free(renderedState);
-	if (renderData.pickup) renderData.dropoff = renderData.pickup;
-	if (renderData.dropoff) {
-		cleanup(renderData.dropoff);
-		free(renderData.dropoff);
+	if (phantomState) {
+		cleanup(phantomState);
+		free(phantomState);
+	}
+	range(i, 3) freeRenderSnapshot(renderSlots.slots[i].rs);
+	{
+		// Anything the render thread didn't get to still needs `cleanupAll` (in `game_destroy`)
+		ggc_msg m;
+		while (ggcRing.pop(&m)) msgs_gfx->add(m);
 	}
 	printf(QUIET_LINE("Done."));
 	printf(QUIET_LINE("Misc cleanup..."));
@@ -1031,12 +1429,13 @@ int main(int argc, char **argv) {
 	config_destroy();
 	file_destroy();
 	syncData.destroy();
+	streamOut.destroy();
+	range(i, streamIn.num) streamIn[i].destroy();
+	streamIn.destroy();
 	outboundData.destroy();
 	outboundTextQueue.destroy();
 	game_destroy(); // Mirror to game_init
 	// TODO: Double-check no leaks
-	msgs_exchange->destroy();
-	delete msgs_exchange;
 	msgs_gfx->destroy();
 	delete msgs_gfx;
 	msgs_game->destroy();
@@ -1045,11 +1444,18 @@ int main(int argc, char **argv) {
 	WSACleanup();
 #endif
 	printf(QUIET_LINE("Done."));
-	printf(QUIET_LINE("Cleaning up GLFW..."));
-	// Necessary so glfwTerminate gets all the loose ends
-	glfwMakeContextCurrent(display);
-	glfwTerminate();
-	printf(QUIET_LINE("Done."));
+#ifndef _WIN32
+	if (headlessSecs) {
+		bench_destroyEgl();
+	} else
+#endif
+	{
+		printf(QUIET_LINE("Cleaning up GLFW..."));
+		// Necessary so glfwTerminate gets all the loose ends
+		glfwMakeContextCurrent(display);
+		glfwTerminate();
+		printf(QUIET_LINE("Done."));
+	}
 	puts("All done!");
 
 	// Someone online said this might clear up some of the dl_open memory leaks.
@@ -1,2 +1,15 @@
+#include <atomic>
+
 extern int renderPhantomFrames;
-extern list<ggc_msg> *msgs_game, *msgs_gfx, *msgs_exchange;
+extern list<ggc_msg> *msgs_game, *msgs_gfx;
+// Snapshots the game thread replaced before the render thread ever picked them up
+extern std::atomic<int> renderFramesOverwritten;
+// Render frames drawn without a new snapshot (render thread only)
+extern int renderFramesRepeated;
+// How far ahead of the server our inputs go out (smoothed), what we're aiming for,
+// and how many frames the phantom re-simulates each time (smoothed, in hundredths)
+extern std::atomic<int> leadAvgMicros, leadTargetMicros, rollbackCenti;
+// How late ticks woke up. Bucket `i` counts wakeups under 2^i microseconds, except the last which takes everything else.
+#define TICK_LATE_BUCKETS 16
+extern std::atomic<int> tickLateHist[TICK_LATE_BUCKETS];
+extern std::atomic<int> tickLateMaxMicros;
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "util.h"
+#include "list.h"
+#include "json.h"
+#include "net2.h"
+#include "gamestate.h"
+#include "game_graphics.h"
+#include "main_graphics.h"
+
+#include "metrics.h"
+
+std::atomic<long> metric_ticks(0);
+std::atomic<int> metric_inputsMicros(0), metric_updateMicros(0), metric_followMicros(0);
+std::atomic<long> metric_resimFrames(0);
+std::atomic<int> metric_rollbackLast(0), metric_rollbackMax(0);
+std::atomic<int> metric_backlog(0);
+std::atomic<long> metric_lateFrames(0), metric_earlyFrames(0);
+std::atomic<int> metric_catchups(0), metric_miaSleeps(0), metric_lateBatches(0);
+std::atomic<long> metric_bytesIn(0), metric_bytesOut(0);
+
+// For rates. Only touched by whoever calls `metrics_json` (the poll thread).
+static long lastNanos = 0, lastResim = 0, lastTicks = 0;
+
+static long nowNanos() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+	return t.tv_sec*1'000'000'000L + t.tv_nsec;
+}
+
+#define LOAD(x) (x).load(std::memory_order::relaxed)
+
+static void setInt(jsonValue *obj, char const *key, long x) {
+	char buf[24];
+	snprintf(buf, 24, "%ld", x);
+	obj->set(key)->initNum(strdup(buf));
+}
+
+static void setNum(jsonValue *obj, char const *key, double x) {
+	char buf[32];
+	snprintf(buf, 32, "%.3f", x);
+	obj->set(key)->initNum(strdup(buf));
+}
+
+void metrics_json(list<char> *out) {
+	long now = nowNanos();
+	long resim = LOAD(metric_resimFrames);
+	long ticks = LOAD(metric_ticks);
+	// Rates are since the previous scrape, so the first scrape just reports 0 for those
+	double secs = lastNanos ? (now - lastNanos) / 1e9 : 0;
+
+	jsonValue root;
+	root.initObj();
+	setInt(&root, "ticks", ticks);
+	setNum(&root, "ticks_per_sec", secs > 0 ? (ticks - lastTicks) / secs : 0);
+	setInt(&root, "resim_frames", resim);
+	setNum(&root, "resim_per_sec", secs > 0 ? (resim - lastResim) / secs : 0);
+	setInt(&root, "rollback_last", LOAD(metric_rollbackLast));
+	setInt(&root, "rollback_max", LOAD(metric_rollbackMax));
+	setNum(&root, "rollback_avg", LOAD(rollbackCenti) / 100.0);
+	setInt(&root, "finalized_backlog", LOAD(metric_backlog));
+	setInt(&root, "late_frames", LOAD(metric_lateFrames));
+	setInt(&root, "early_frames", LOAD(metric_earlyFrames));
+	setInt(&root, "late_batches", LOAD(metric_lateBatches));
+	setInt(&root, "catchups", LOAD(metric_catchups));
+	setInt(&root, "mia_sleeps", LOAD(metric_miaSleeps));
+	setInt(&root, "bytes_in", LOAD(metric_bytesIn));
+	setInt(&root, "bytes_out", LOAD(metric_bytesOut));
+	setNum(&root, "lead_ms", LOAD(leadAvgMicros) / 1e3);
+	setNum(&root, "lead_target_ms", LOAD(leadTargetMicros) / 1e3);
+	setNum(&root, "rtt_ms", LOAD(net2_rttMicros) / 1e3);
+	setNum(&root, "jitter_ms", LOAD(net2_jitterMicros) / 1e3);
+	setInt(&root, "net_frames", LOAD(net2_frames));
+	setInt(&root, "net_max_batch", LOAD(net2_maxBatch));
+	{
+		jsonValue *phases = root.set("tick_us");
+		phases->initObj();
+		setInt(phases, "inputs", LOAD(metric_inputsMicros));
+		setInt(phases, "update", LOAD(metric_updateMicros));
+		setInt(phases, "follow", LOAD(metric_followMicros));
+	}
+	{
+		// Bucket `i` is wakeups under 2^i us, see `tickLateHist`
+		jsonValue *hist = root.set("wake_late_hist");
+		hist->initArr();
+		list<jsonValue> *items = hist->getItems();
+		range(i, TICK_LATE_BUCKETS) {
+			char buf[24];
+			snprintf(buf, 24, "%d", LOAD(tickLateHist[i]));
+			items->add().initNum(strdup(buf));
+		}
+		setInt(&root, "wake_late_max_us", LOAD(tickLateMaxMicros));
+	}
+
+	jsonSerialize(out, &root, -1);
+	out->add('\n');
+	root.destroy();
+
+	lastNanos = now;
+	lastResim = resim;
+	lastTicks = ticks;
+}
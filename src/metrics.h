@@ -0,0 +1,26 @@
+#pragma once
+
+#include <atomic>
+
+#include "list.h"
+
+// Counters for the `/metrics` HTTP endpoint (and the `--headless` summary).
+// Each is written by whichever thread owns the thing being counted, and can be read from anywhere.
+// Totals are since startup.
+
+// Game thread ticks, and how long the last one spent in each phase (see `timekeeping`)
+extern std::atomic<long> metric_ticks;
+extern std::atomic<int> metric_inputsMicros, metric_updateMicros, metric_followMicros;
+// Phantom steps re-simulated after a rollback, and how deep the last / deepest rollback was
+extern std::atomic<long> metric_resimFrames;
+extern std::atomic<int> metric_rollbackLast, metric_rollbackMax;
+// Finalized frames that were waiting for the game thread at the start of its last tick
+extern std::atomic<int> metric_backlog;
+// Finalized frames our input missed, and frames somebody else's input arrived for before we'd even predicted them
+extern std::atomic<long> metric_lateFrames, metric_earlyFrames;
+// Times we had to catch up (see `catchupMode`), slept because the server went quiet, or got penalized for being late
+extern std::atomic<int> metric_catchups, metric_miaSleeps, metric_lateBatches;
+// Game traffic to / from the server (or the relay, see relay.cpp)
+extern std::atomic<long> metric_bytesIn, metric_bytesOut;
+
+extern void metrics_json(list<char> *out);
@@ -77,7 +77,7 @@ void* mypoll_threadFunc(void *arg) {
 #undef ANY_CHECK
 }
 
-void mypoll_init() {
+void mypoll_init(char serverless) {
 	// Shouldn't happen
 	if (net_fd == -1) {
 		puts("ERROR: net_fd == -1");
@@ -143,12 +143,12 @@ void* mypoll_threadFunc(void *arg) {
 	}
 }
 
-void mypoll_init() {
+void mypoll_init(char serverless) {
 	// If components are init'd in the right order, this shouldn't happen.
 	//
 	// The init order is hardcoded, so the only thing I can think of is
 	// if one of these other components fails without calling `exit()`.
-	if (net_fd == -1) {
+	if (net_fd == -1 && !serverless) {
 		puts("ERROR: net_fd == -1");
 		exit(1);
 	}
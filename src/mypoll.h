@@ -10,6 +10,7 @@ extern char poll_game_data[POLL_BUF_LEN];
 
 extern void* mypoll_threadFunc(void *arg);
 
-extern void mypoll_init();
+// `serverless` is for when we're the relay (see relay.cpp), and there's no server socket to watch
+extern void mypoll_init(char serverless);
 
 extern void mypoll_destroy();
@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <string.h>
 
@@ -16,14 +17,30 @@
 
 #include "util.h"
 #include "main.h"
+#include "metrics.h"
 
-#define BUF_SIZE 4096
+// Incoming data lands in "slabs", which are used round-robin like a ring buffer.
+// `net2.cpp` hands out pointers straight into them (see `net_view`), so a slab can't be
+// reused until every view into it is released; that's what `refs` counts.
+// Slabs are normally SLAB_SIZE, but a message that doesn't fit gets a bigger one to itself.
+#define SLAB_SIZE (256*1024)
+#define MAX_SLABS 64
+
+struct slab {
+	char *data; // NULL if this entry isn't allocated
+	int size;
+	int refs;
+};
 
 // ofc this would all be in a struct or something in a perfect OO world
 int net_fd = -1;
-static char buf[BUF_SIZE];
+static struct slab slabs[MAX_SLABS];
+static int cur = -1;
+static char *buf = NULL;
 static int buf_ix = 0;
 static int buf_len = 0;
+// Start of the view being built, or -1
+static int mark = -1;
 
 char initSocket(const char *srvAddr, const char* port){
 #ifdef _WIN32
@@ -145,14 +162,63 @@ void closeSocket() {
 	net_fd = -1;
 }
 
-char readData(void *dst_arg, int len) {
-	char *dst = (char*)dst_arg;
+static void dropSlab(int ix) {
+	struct slab *sl = &slabs[ix];
+	// Oversized slabs are only for one big message, so give the memory back.
+	if (sl->size > SLAB_SIZE) {
+		free(sl->data);
+		sl->data = NULL;
+	}
+}
+
+// Moves unconsumed bytes (and the view in progress) somewhere with room for `len` more
+static char makeRoom(int len) {
+	int keep = mark == -1 ? buf_ix : mark;
+	int need = buf_ix - keep + len;
+	if (cur != -1 && !slabs[cur].refs && need <= slabs[cur].size) {
+		// Nobody's looking at this one, just slide everything back to the start
+		memmove(buf, buf + keep, buf_len - keep);
+	} else {
+		int size = need > SLAB_SIZE ? need : SLAB_SIZE;
+		int next = -1;
+		range(i, MAX_SLABS) {
+			struct slab *sl = &slabs[i];
+			if (i == cur || sl->refs) continue;
+			if (sl->data && sl->size >= size) {
+				next = i;
+				break;
+			}
+			if (!sl->data && next == -1) next = i;
+		}
+		if (next == -1) {
+			puts("Out of network receive slabs, are views not being released?");
+			return 1;
+		}
+		struct slab *sl = &slabs[next];
+		if (!sl->data) {
+			sl->data = (char*)malloc(size);
+			sl->size = size;
+		}
+		if (cur != -1) {
+			memcpy(sl->data, buf + keep, buf_len - keep);
+			if (!slabs[cur].refs) dropSlab(cur);
+		}
+		cur = next;
+		buf = sl->data;
+	}
+	buf_len -= keep;
+	buf_ix -= keep;
+	if (mark != -1) mark = 0;
+	return 0;
+}
+
+// Blocks until at least `len` unconsumed bytes are in `buf`
+static char fill(int len) {
 	while (buf_ix + len > buf_len) {
-		int available = buf_len - buf_ix;
-		memcpy(dst, buf + buf_ix, available);
-		len -= available;
-		dst += available;
-		int ret = recv(net_fd, buf, BUF_SIZE, 0);
+		if (cur == -1 || buf_ix + len > slabs[cur].size) {
+			if (makeRoom(len)) return 1;
+		}
+		int ret = recv(net_fd, buf + buf_len, slabs[cur].size - buf_len, 0);
 		if (ret == 0) {
 			if (globalRunning) puts("Remote host closed connection.");
 			return 1;
@@ -168,15 +234,92 @@ char readData(void *dst_arg, int len) {
 			}
 			return 1;
 		}
-		buf_len = ret;
-		buf_ix = 0;
+		buf_len += ret;
+		metric_bytesIn += ret;
 	}
+	return 0;
+}
 
+char net_feed(char const *src, int len) {
+	if (cur == -1 || buf_len + len > slabs[cur].size) {
+		if (makeRoom(buf_len - buf_ix + len)) return 1;
+	}
+	memcpy(buf + buf_len, src, len);
+	buf_len += len;
+	metric_bytesIn += len;
+	return 0;
+}
+
+char readData(void *dst, int len) {
+	if (fill(len)) return 1;
 	memcpy(dst, buf + buf_ix, len);
 	buf_ix += len;
 	return 0;
 }
 
+char skipData(int len) {
+	if (fill(len)) return 1;
+	buf_ix += len;
+	return 0;
+}
+
+int bufferedData() {
+	return buf_len - buf_ix;
+}
+
+void net_mark() {
+	mark = buf_ix;
+}
+
+char* net_view(int *len) {
+	char *ret = buf + mark;
+	*len = buf_ix - mark;
+	slabs[cur].refs++;
+	mark = -1;
+	return ret;
+}
+
+void net_unmark() {
+	mark = -1;
+}
+
+void net_release(char const *view) {
+	range(i, MAX_SLABS) {
+		struct slab *sl = &slabs[i];
+		if (!sl->data || view < sl->data || view >= sl->data + sl->size) continue;
+		sl->refs--;
+		if (!sl->refs && i != cur) dropSlab(i);
+		return;
+	}
+	puts("net_release: that's not a view we handed out!");
+}
+
+void net_destroy() {
+	range(i, MAX_SLABS) {
+		free(slabs[i].data);
+		slabs[i].data = NULL;
+	}
+	cur = -1;
+	buf = NULL;
+	buf_ix = buf_len = 0;
+}
+
+char net_rtt(int *rttMicros, int *jitterMicros) {
+#ifdef _WIN32
+	// Windows has `SIO_TCP_INFO`, but only recent versions. Not worth it for now.
+	return 1;
+#else
+	// The kernel already keeps a smoothed RTT and its variance for us.
+	// ACKs from the server may be delayed a bit, so this errs high, which is the safe direction.
+	struct tcp_info info;
+	socklen_t len = sizeof(info);
+	if (net_fd == -1 || getsockopt(net_fd, IPPROTO_TCP, TCP_INFO, &info, &len)) return 1;
+	*rttMicros = info.tcpi_rtt;
+	*jitterMicros = info.tcpi_rttvar;
+	return 0;
+#endif
+}
+
 // Todo: Nearly duplicated in http.cpp
 char sendData(char *src, int len) {
 	while (len) {
@@ -193,6 +336,7 @@ char sendData(char *src, int len) {
 		}
 		src += ret;
 		len -= ret;
+		metric_bytesOut += ret;
 	}
 	return 0;
 }
@@ -2,6 +2,23 @@ extern int net_fd;
 
 extern char initSocket(const char *srvAddr, const char *port);
 extern char readData(void *dst, int len);
+// Like `readData`, but doesn't copy the bytes anywhere (for use with `net_view`)
+extern char skipData(int len);
+// Hands over bytes as if they'd come in on the socket, for when there isn't one (see relay.cpp).
+// Returns 1 if there's nowhere to put them.
+extern char net_feed(char const *src, int len);
+// How many bytes `readData` can hand out without touching the socket
+extern int bufferedData();
+// Everything read between `net_mark` and `net_view` is kept in place and handed back
+// as one contiguous block, so it doesn't have to be copied out. It stays valid until
+// it's passed to `net_release`. `net_unmark` abandons a view (e.g. on a read error).
+extern void net_mark();
+extern char* net_view(int *len);
+extern void net_unmark();
+extern void net_release(char const *view);
+extern void net_destroy();
+// Returns 1 if there's no measurement (or the platform doesn't give us one)
+extern char net_rtt(int *rttMicros, int *jitterMicros);
 extern char sendData(char *src, int len);
 extern void net_close(char const *ctx, int fd);
 extern void closeSocket();
@@ -7,6 +7,8 @@
 #include <arpa/inet.h>
 #endif
 
+#include <time.h>
+
 #include "util.h"
 #include "list.h"
 #include "queue.h"
@@ -31,9 +33,13 @@ char asleep = 0;
 
 // ============= End mutex lock ==============
 
+std::atomic<long> net2_wakeups, net2_frames, net2_maxBatch;
+std::atomic<long> net2_lockNanos, net2_maxLockNanos;
+std::atomic<int> net2_rttMicros(0), net2_jitterMicros(0);
+net2_frameTime net2_recvTimes[NET2_TIMES];
+
 static int numPlayers, maxPlayers;
 static int32_t expectedFrame;
-static list<list<char>> availBuffers;
 // The dummy buffer should be read-only, so the `max` doesn't matter.
 // We set it to 0 to have an easy way to test for it.
 static const list<char> dummyBuffer = {.items = (char*)(char const[]){0}, .num = 1, .max = 0};
@@ -46,32 +52,47 @@ struct message {
 
 static list<message> pendingMessages;
 
-// A "normal" message should be under 50 bytes; at time of writing, it's about 16 for frame data, plus any command / chat.
-#define MSG_SIZE_GUESS 50
 // Shouldn't be possible to get this from the server if it's doing its job,
 // as you can't build a message this big without either exhausting your usage pool or skipping too many frames.
 #define MAX_CMD_LEN (6*1024*1024)
 
+static long nowNanos() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+	return t.tv_sec*1'000'000'000L + t.tv_nsec;
+}
+
+// Message buffers aren't copies, they point straight into `net.c`'s receive slabs
+// (which conveniently already have the layout the game thread wants).
+// They have to be handed back once the game thread is definitely done with them.
 static void reclaimBuffer(list<char> *buf) {
-	// A "big" message, like a level load, is in the 10K range.
-	// Todo: This is a `realloc`, which we could try to move outside of the mutex'd region
-	//       if we really wanted. (`reclaimBuffer` is mostly called from the mutex'd region
-	//       currently.)
-	if (buf->max > 1'000) buf->setMax(MSG_SIZE_GUESS);
-	buf->num = 0;
-	availBuffers.add(*buf);
+	net_release(buf->items);
 }
 
-static void supplyBuffer(list<char> *buf) {
-	if (availBuffers.num) {
-		availBuffers.num--;
-		*buf = availBuffers[availBuffers.num];
-	} else {
-		buf->init(MSG_SIZE_GUESS);
+static char readMessageBody() {
+	u8 size;
+	if (readData(&size, 1)) return 1;
+	if (skipData(size)) return 1;
+
+	// Now read in any commands
+	if (readData(&size, 1)) return 1;
+	while (size--) {
+		uint32_t netCmdLen;
+		if (readData(&netCmdLen, 4)) return 1;
+		uint32_t cmdLen = ntohl(netCmdLen);
+		if (cmdLen > MAX_CMD_LEN) {
+			printf("Got cmd len 0x%X, which server should prevent!\n", cmdLen);
+			return 1;
+		}
+		if (skipData(cmdLen)) return 1;
 	}
+	return 0;
 }
 
-char net2_read() {
+// Parses one frame's worth of messages into `pendingMessages`.
+// `batchIx` is how many frames came before this one in the current `net2_read`,
+// so frame offsets end up relative to the first frame of the batch.
+static char readFrame(int batchIx, int *mostAhead) {
 	int32_t frame;
 	if (readData(&frame, 4)) return 1;
 	frame = ntohl(frame);
@@ -81,11 +102,12 @@ char net2_read() {
 	}
 	expectedFrame = (expectedFrame + 1) % FRAME_ID_MAX;
 
-	int mostAhead = 0;
+	// Even if nobody sends anything, this frame itself needs a buffer group
+	if (batchIx > *mostAhead) *mostAhead = batchIx;
 
 	{
 		unsigned char tmp;
-		readData(&tmp, 1);
+		if (readData(&tmp, 1)) return 1;
 		numPlayers = tmp;
 	}
 	if (numPlayers != maxPlayers) {
@@ -118,42 +140,63 @@ char net2_read() {
 				printf("Invalid frame offset %d (%d - %d)\n", frameOffset, msgFrame, frame);
 			}
 #endif
-			if (frameOffset > mostAhead) mostAhead = frameOffset;
-
+			frameOffset += batchIx;
+			if (frameOffset > *mostAhead) *mostAhead = frameOffset;
+
+			// The rest of the message is kept as-is: input size, inputs, command count, and commands
+			net_mark();
+			if (readMessageBody()) {
+				net_unmark();
+				return 1;
+			}
 			message *m = &pendingMessages.add();
-			supplyBuffer(&m->data);
-			list<char> &data = m->data;
 			m->player = i;
 			m->frameOffset = frameOffset;
-
-			u8 size;
-			if (readData(&size, 1)) return 1;
-
-			data.setMaxUp(1+size);
-			data[0] = size;
-			if (readData(data.items+1, size)) return 1;
-			data.num = 1+size;
-
-			// Now read in any commands
-			if (readData(&size, 1)) return 1;
-			data.add(size);
-			while (size--) {
-				uint32_t netCmdLen;
-				if (readData(&netCmdLen, 4)) return 1;
-				uint32_t cmdLen = ntohl(netCmdLen);
-				if (cmdLen > MAX_CMD_LEN) {
-					printf("Got cmd len 0x%X, which server should prevent!\n", cmdLen);
-					return 1;
-				}
-				int end = data.num + cmdLen + 4;
-				data.setMaxUp(end);
-				*(int32_t*)(data.items + data.num) = netCmdLen;
-				if (readData(data.items + data.num + 4, cmdLen)) return 1;
-				data.num = end;
-			}
+			int len;
+			m->data.items = net_view(&len);
+			// Non-zero `max` is how the game thread tells real data from `dummyBuffer`
+			m->data.num = m->data.max = len;
 		}
 	}
+	return 0;
+}
 
+static void dropPendingFrom(int ix) {
+	for (int i = ix; i < pendingMessages.num; i++) {
+		reclaimBuffer(&pendingMessages[i].data);
+	}
+	pendingMessages.num = ix;
+}
+
+static void updateMax(std::atomic<long> *x, long val) {
+	// Only the poll thread writes these, so no need for a CAS loop
+	if (val > x->load(std::memory_order::relaxed)) x->store(val, std::memory_order::relaxed);
+}
+
+char net2_read() {
+	// Parse everything that's already arrived before touching the mutex.
+	// After a stall there can be dozens of frames sitting in the buffer,
+	// and we don't want to trade the lock back and forth with the game thread for each one.
+	long t0 = nowNanos();
+	int32_t firstFrame = expectedFrame;
+	int numFrames = 0;
+	int mostAhead = 0;
+	char failed = 0;
+	do {
+		int pendingStart = pendingMessages.num;
+		int aheadStart = mostAhead;
+		if (readFrame(numFrames, &mostAhead)) {
+			// Whatever frames we finished are still good, so publish those before bailing
+			dropPendingFrom(pendingStart);
+			mostAhead = aheadStart;
+			failed = 1;
+			break;
+		}
+		numFrames++;
+	} while (bufferedData());
+	if (!numFrames) return 1;
+
+	long t1 = nowNanos();
 	// Now putting all that info into mutex'd vars for the game thread to make use of.
 	mtx_lock(netMutex);
 
@@ -211,18 +254,35 @@ char net2_read() {
 	}
 	pendingMessages.num = 0;
 
-	// We never advance `finalizedFrames` more than one step, even if everybody's already got their data in ahead of time.
+	// For each frame we parsed, we never advance `finalizedFrames` more than one step, even if everybody's already got their data in ahead of time.
 	// Partly this might be a holdover (there have been some tweaks to how this nonsense works),
 	// but I think it's also partly because a *new player* might potentially connect and send data for the frame.
 	// If we're over-zealous about finalizing frames we can't respond to that
 	// (probably desyncing from that player, if not from others).
-	finalizedFrames++;
+	finalizedFrames += numFrames;
+	range(i, numFrames) {
+		int32_t frame = (firstFrame + i) % FRAME_ID_MAX;
+		net2_recvTimes[frame % NET2_TIMES] = {.frame = frame, .nanos = t0};
+	}
 
 	if (asleep) {
 		mtx_signal(netCond);
 	}
 	mtx_unlock(netMutex);
-	return 0;
+
+	long held = nowNanos() - t1;
+	net2_wakeups.fetch_add(1, std::memory_order::relaxed);
+	net2_frames.fetch_add(numFrames, std::memory_order::relaxed);
+	net2_lockNanos.fetch_add(held, std::memory_order::relaxed);
+	updateMax(&net2_maxBatch, numFrames);
+	updateMax(&net2_maxLockNanos, held);
+
+	int rtt, jitter;
+	if (!net_rtt(&rtt, &jitter)) {
+		net2_rttMicros.store(rtt, std::memory_order::relaxed);
+		net2_jitterMicros.store(jitter, std::memory_order::relaxed);
+	}
+	return failed;
 }
 
 void net2_init(int _numPlayers, int _frame) {
@@ -234,27 +294,13 @@ void net2_init(int _numPlayers, int _frame) {
 	range(i, numPlayers) starterFrame.add(dummyBuffer);
 	finalizedFrames = 1;
 
-	availBuffers.init();
 	pendingMessages.init();
 }
 
 void net2_destroy() {
-	range(i, pendingMessages.num) {
-		reclaimBuffer(&pendingMessages[i].data);
-	}
 	pendingMessages.destroy();
 
-	range(i, availBuffers.num) {
-		availBuffers[i].destroy();
-	}
-	availBuffers.destroy();
-
-	range(i, frameData.max) {
-		list<list<char>> &players = frameData.items[i];
-		range(j, players.num) {
-			if (players[j].max) players[j].destroy();
-		}
-		// players.destroy(); // Handled by `frameData.destroy()`, since the queue was responsible for initing them
-	}
+	// Anything still in `frameData` (or `pendingMessages`) is a view into `net.c`'s slabs, which we're about to free wholesale
 	frameData.destroy();
+	net_destroy();
 }
@@ -1,3 +1,5 @@
+#include <atomic>
+
 #include "mtx.h"
 #include "queue.h"
 #include "list.h"
@@ -18,6 +20,25 @@ extern char asleep;
 
 // ============= End mutex lock ==============
 
+// Stats for the overlay, only ever written by the poll thread.
+// Totals since startup: `net2_read` calls that got at least one frame, frames, and time spent holding `netMutex`.
+extern std::atomic<long> net2_wakeups, net2_frames, net2_lockNanos;
+// Most frames handled by one `net2_read`, and longest `netMutex` hold
+extern std::atomic<long> net2_maxBatch, net2_maxLockNanos;
+
+// Network round trip and its variation, as the TCP stack sees it (0 if unknown)
+extern std::atomic<int> net2_rttMicros, net2_jitterMicros;
+
+// When each frame's data showed up (CLOCK_MONOTONIC_RAW nanos), for working out how far ahead our inputs are.
+// Indexed by frame % NET2_TIMES; if `frame` doesn't match, it's been overwritten. Guarded by `netMutex`.
+#define NET2_TIMES 128
+struct net2_frameTime {
+	int32_t frame;
+	long nanos;
+};
+extern net2_frameTime net2_recvTimes[NET2_TIMES];
+
+// Handles every frame that's already buffered, publishing them all with one trip through `netMutex`.
 // This may actually block if only part of a frame's data is currently available.
 // This is fine for now - it's not common (unless server is malicious?), and even
 // if it did happen a lot, there's not a lot else that contends for the attention
@@ -18,6 +18,9 @@ int64_t pl_walkForce = 60;
 int64_t pl_jump = 400;
 int64_t pl_gummy = 80;
 
+// Only used on the game thread
+static bcaster shotCaster;
+
 // TODO: We'll deal with this later, but I don't think the input desire should be rotated.
 //       Instead, just project it onto the lateral plane and scale it up.
 //       It may come out to be the zero vector, that's okay too.
@@ -200,22 +203,24 @@ static void shoot(gamestate *gs, player *p) {
 	iquat_apply(look, p->m.rot, ((unitvec const){0, FIXP, 0}));
 
 	fraction const limit = {.numer = PL_SHOOT_RANGE, .denom = FIXP};
-	// Todo: I think this may be a bit sloppy at the moment, since a box that's a suitable
-	//       parent for something that large will necessarily be bigger than we need.
-	//       Might be able to improve this with a small velbox tweak involving `minParentR`.
-	box *queryArea = velbox_findParent(p->prox, p->m.oldPos, p->vel, limit.numer);
-	bcast_start(queryArea, look, p->m.oldPos);
-	fraction time;
-	mover *result;
-	do {
-		result = bcast(&time, look, p->m.oldPos);
-	} while (result == &p->m);
-	if (!result) {
-		time = limit;
-	} else if (limit.lt(time)) {
-		time = limit;
-		result = NULL;
+	// Query with the smallest cube that holds the whole shot, centered on the middle of it.
+	// Previously this used the full range as the radius (centered on the shooter),
+	// which meant a parent box far bigger than we need.
+	offset mid;
+	int32_t maxLook = 0;
+	range(i, 3) {
+		mid[i] = p->m.oldPos[i] + (int64_t)look[i] * (PL_SHOOT_RANGE/2) / FIXP;
+		int32_t a = abs(look[i]);
+		if (a > maxLook) maxLook = a;
 	}
+	// +1 to cover any rounding in `mid`
+	int64_t queryR = (int64_t)maxLook * (PL_SHOOT_RANGE/2) / FIXP + 1;
+	box *queryArea = velbox_findParent(p->prox, mid, p->vel, queryR);
+
+	shotCaster.start(queryArea, look, p->m.oldPos, limit, &p->m);
+	fraction time;
+	mover *result = shotCaster.first(&time);
+	if (!result) time = limit;
 	// Guns happen at the start of the step,
 	// so we have to subtract 1 from the clock
 	int32_t soundTime = gs->clock - 1;
@@ -295,3 +300,11 @@ void pl_postStep(gamestate *gs, player *p) {
 		shoot(gs, p);
 	}
 }
+
+void pl_init() {
+	shotCaster.init();
+}
+
+void pl_destroy() {
+	shotCaster.destroy();
+}
@@ -11,3 +11,6 @@ extern int64_t pl_gummy;
 
 extern void pl_phys_standard(gamestate *gs, unitvec const forceDir, offset const contactVel, int64_t dist, offset dest, player *p);
 extern void pl_postStep(gamestate *gs, player *p);
+
+extern void pl_init();
+extern void pl_destroy();
@@ -0,0 +1,607 @@
+#ifndef _WIN32
+// In-process version of `server.py`, for the hosting player. See that file for the details of the
+// protocol and the reasoning behind the rules; this is meant to behave the same from the outside.
+// Differences: the host is always client 0, and never goes over a socket. Its data is parsed
+// straight out of `relay_hostSend`, and every broadcast is handed to `net2_read` directly.
+// There's no data-rate limiting here, since this is meant for friends on a LAN;
+// anything public-facing should still use `server.py`.
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "util.h"
+#include "list.h"
+#include "mtx.h"
+#include "main.h"
+#include "net.h"
+#include "net2.h"
+#include "metrics.h"
+
+#include "relay.h"
+
+// These should match server.py (and MAGIC_FIRST_BYTE is really game_callbacks.h's, it's just a pain to include here)
+#define MAGIC_FIRST_BYTE 0x96
+#define FRAMERATE 15
+#define MAX_CLIENTS 32
+#define MAX_SPECTATORS 64
+#define MAX_CMD_COUNT 16
+#define MAX_MISSED_FRAMES (10*FRAMERATE)
+#define SPECTATOR_PORT_OFFSET 1
+#define SPECTATOR_CMD "/spectator"
+
+#define FRAME_NANOS (1'000'000'000L / FRAMERATE)
+// Nobody legit sends a single command this big (state goes out in 64KB chunks)
+#define MAX_CMD_LEN (4*1024*1024)
+// Most we'll hold of a client's half-arrived frame. That's enough for one max-size command, with room to spare.
+#define MAX_PENDING_IN (MAX_CMD_LEN + 1024)
+// Remote clients that aren't reading get dropped rather than buffered forever
+#define MAX_BACKLOG (4*1024*1024)
+
+// One frame's worth of data from a client, waiting for the next broadcast.
+// These get reused, so everything up to `msgs.max` is initialized.
+struct relayMsg {
+	list<char> head; // Frame number and payload
+	list<char> cmds; // Each with its 4-byte length
+	int numCmds;
+};
+
+struct relayClient {
+	int fd; // -1 for the host
+	char inited;
+	list<char> in;
+	list<char> out;
+	list<relayMsg> msgs;
+	char offsetsUsed[MAX_AHEAD+1];
+	int offsetsOffset;
+	int missedFrames;
+};
+
+static int listenFd = -1, spectatorFd = -1;
+// Indexed by player slot, NULL if the slot's free. Only the relay thread touches this list
+// (adding to it can move it around), so the game thread gets at the host via `hostClient` instead.
+static list<relayClient*> clients;
+// Always `clients[0]`
+static relayClient *hostClient = NULL;
+static list<relayClient*> spectators;
+static char spectatorSync = 0;
+static int32_t frame = 0;
+// Guards the host's `relayClient` (which the game thread writes to), and `frame` (which it reads)
+static mtx_t relayMutex = MTX_INIT_EXPR;
+static list<char> broadcast;
+static list<struct pollfd> fds;
+static pthread_t relayThread;
+static char relayRunning = 0;
+// Set (with `relayMutex`) if the relay thread gave up; the host's data goes nowhere after that
+static char relayFailed = 0;
+
+static void append(list<char> *l, void const *src, int len) {
+	l->setMaxUp(l->num + len);
+	memcpy(l->items + l->num, src, len);
+	l->num += len;
+}
+
+static void appendInt(list<char> *l, int32_t x) {
+	x = htonl(x);
+	append(l, &x, 4);
+}
+
+static relayClient* mkClient(int fd) {
+	relayClient *c = new relayClient();
+	c->fd = fd;
+	c->inited = 0;
+	c->in.init();
+	c->out.init();
+	c->msgs.init();
+	range(i, c->msgs.max) {
+		c->msgs[i].head.init();
+		c->msgs[i].cmds.init();
+	}
+	memset(c->offsetsUsed, 0, sizeof(c->offsetsUsed));
+	c->offsetsOffset = 0;
+	c->missedFrames = 0;
+	return c;
+}
+
+static void freeClient(relayClient *c) {
+	if (c->fd != -1) net_close("relay client", c->fd);
+	c->in.destroy();
+	c->out.destroy();
+	range(i, c->msgs.max) {
+		c->msgs[i].head.destroy();
+		c->msgs[i].cmds.destroy();
+	}
+	c->msgs.destroy();
+	delete c;
+}
+
+static int32_t readInt(char const *p) {
+	return ntohl(*(int32_t*)p);
+}
+
+// How far ahead of the current frame `requested` is (negative if it's late)
+static int32_t frameDelt(int32_t requested) {
+	return (requested - frame + FRAME_ID_MAX/2 + FRAME_ID_MAX) % FRAME_ID_MAX - FRAME_ID_MAX/2;
+}
+
+// How many commands a frame for `requested` can still carry; same slot logic as `recordFrame`.
+// Lets `parseClient` turn down a frame with too many before buffering all of it.
+static int cmdRoom(relayClient *c, int32_t requested) {
+	int32_t delt = frameDelt(requested);
+	if (delt < 0) delt = 0;
+	else if (delt > MAX_AHEAD) delt = MAX_AHEAD;
+	if (!c->offsetsUsed[(c->offsetsOffset + delt) % (MAX_AHEAD + 1)] || !c->msgs.num) return MAX_CMD_COUNT;
+	return MAX_CMD_COUNT - c->msgs[c->msgs.num - 1].numCmds;
+}
+
+// Same logic as `record_complete_frame` in server.py
+static char recordFrame(relayClient *c, int ix, int32_t requested, char const *payload, int payloadLen, char const *cmds, int cmdsLen, int numCmds) {
+	int32_t f = requested;
+	int32_t delt = frameDelt(f);
+	if (delt < 0) {
+		printf("Relay: client %d delivered packet %d frames late\n", ix, -delt);
+		f = frame;
+		delt = 0;
+	} else if (delt > MAX_AHEAD) {
+		printf("Relay: client %d delivered packet %d frames early, when the max allowed is %d\n", ix, delt, MAX_AHEAD);
+		f = (frame + MAX_AHEAD) % FRAME_ID_MAX;
+		delt = MAX_AHEAD;
+	}
+
+	int offsetIx = (c->offsetsOffset + delt) % (MAX_AHEAD + 1);
+	if (!c->offsetsUsed[offsetIx]) {
+		c->offsetsUsed[offsetIx] = 1;
+		if (c->msgs.num == c->msgs.max) {
+			// Grows the list, and initializes everything that's newly available
+			int old = c->msgs.max;
+			c->msgs.setMax(old*2 + 1);
+			for (int i = old; i < c->msgs.max; i++) {
+				c->msgs[i].head.init();
+				c->msgs[i].cmds.init();
+			}
+		}
+		relayMsg &m = c->msgs[c->msgs.num++];
+		m.head.num = m.cmds.num = 0;
+		m.numCmds = 0;
+		appendInt(&m.head, f);
+		append(&m.head, payload, payloadLen);
+	}
+	if (!c->msgs.num) {
+		// Server.py explains why this can't happen
+		puts("Relay: no message to attach commands to?");
+		return 0;
+	}
+	relayMsg &latest = c->msgs[c->msgs.num - 1];
+	if (latest.numCmds + numCmds > MAX_CMD_COUNT) {
+		printf("Relay: closing client %d for trying to queue too many commands\n", ix);
+		return 1;
+	}
+	append(&latest.cmds, cmds, cmdsLen);
+	latest.numCmds += numCmds;
+	return 0;
+}
+
+// Pulls every complete frame out of `c->in`. Returns 1 if the client is misbehaving.
+static char parseClient(relayClient *c, int ix) {
+	char const *data = c->in.items;
+	int len = c->in.num;
+	int pos = 0;
+	char bad = 0;
+	while (1) {
+		// [frame (4)][payload size (1)][payload][num cmds (1)]{[cmd size (4)][cmd]}
+		if (len - pos < 5) break;
+		int32_t requested = readInt(data + pos);
+		if (requested < 0 || requested >= FRAME_ID_MAX) {
+			printf("Relay: bad frame number %d from client %d\n", requested, ix);
+			bad = 1;
+			break;
+		}
+		int payloadLen = 1 + (u8)data[pos+4];
+		int p = pos + 4 + payloadLen;
+		if (len - p < 1) break;
+		int numCmds = (u8)data[p];
+		p++;
+		if (numCmds > cmdRoom(c, requested)) {
+			printf("Relay: closing client %d for trying to queue too many commands\n", ix);
+			bad = 1;
+			break;
+		}
+		int cmdsStart = p;
+		char complete = 1;
+		range(i, numCmds) {
+			if (len - p < 4) {
+				complete = 0;
+				break;
+			}
+			int32_t cmdLen = readInt(data + p);
+			if (cmdLen < 0 || cmdLen > MAX_CMD_LEN) {
+				printf("Relay: bad command size %d from client %d\n", cmdLen, ix);
+				bad = 1;
+				break;
+			}
+			if (len - p - 4 < cmdLen) {
+				complete = 0;
+				break;
+			}
+			p += 4 + cmdLen;
+		}
+		if (bad || !complete) break;
+		if (recordFrame(c, ix, requested, data + pos + 4, payloadLen, data + cmdsStart, p - cmdsStart, numCmds)) {
+			bad = 1;
+			break;
+		}
+		pos = p;
+	}
+	if (pos) {
+		memmove(c->in.items, c->in.items + pos, len - pos);
+		c->in.num = len - pos;
+	}
+	if (!bad && c->in.num > MAX_PENDING_IN) {
+		printf("Relay: closing client %d for sending a frame that's way too big\n", ix);
+		bad = 1;
+	}
+	return bad;
+}
+
+// Returns 1 if the client should be dropped
+static char flush(relayClient *c) {
+	if (!c->out.num) return 0;
+	int ret = send(c->fd, c->out.items, c->out.num, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) ret = 0;
+		else return 1;
+	}
+	memmove(c->out.items, c->out.items + ret, c->out.num - ret);
+	c->out.num -= ret;
+	if (c->out.num > MAX_BACKLOG) {
+		puts("Relay: dropping a client that isn't keeping up");
+		return 1;
+	}
+	return 0;
+}
+
+static void dropClient(int ix) {
+	printf("Relay: connection to client %d lost\n", ix);
+	freeClient(clients[ix]);
+	// Slots never go away (clients don't like the player count shrinking), it's just empty now
+	clients[ix] = NULL;
+}
+
+static void dropSpectator(int ix) {
+	puts("Relay: connection to spectator lost");
+	freeClient(spectators[ix]);
+	spectators.stableRmAt(ix);
+}
+
+static void acceptOn(int fd, char spectator) {
+	int clientFd = accept(fd, NULL, NULL);
+	if (clientFd == -1) {
+		printf("WARN: relay `accept` failed with: %s (%s)\n", strerrorname_np(errno), strerror(errno));
+		return;
+	}
+	int flag = 1;
+	setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(int));
+	relayClient *c = mkClient(clientFd);
+	if (spectator) {
+		if (spectators.num >= MAX_SPECTATORS) {
+			puts("Relay: rejecting spectator because MAX_SPECTATORS reached");
+			freeClient(c);
+			return;
+		}
+		spectators.add(c);
+		spectatorSync = 1;
+		puts("Relay: connected spectator");
+		return;
+	}
+	int ix = 0;
+	while (ix < clients.num && clients[ix]) ix++;
+	if (ix >= MAX_CLIENTS) {
+		puts("Relay: rejecting client because MAX_CLIENTS reached");
+		freeClient(c);
+		return;
+	}
+	if (ix == clients.num) clients.add(c);
+	else clients[ix] = c;
+	printf("Relay: connected client at position %d\n", ix);
+}
+
+// Builds and sends out one frame. Caller holds `relayMutex`.
+static void tick() {
+	int numClients = clients.num;
+	if (spectatorSync) {
+		// Same trick as server.py: any message with room for another command will do,
+		// they're processed the same by everyone. Otherwise we try again next frame.
+		range(i, numClients) {
+			relayClient *c = clients[i];
+			if (!c || !c->msgs.num) continue;
+			relayMsg &m = c->msgs[c->msgs.num - 1];
+			if (m.numCmds >= MAX_CMD_COUNT) continue;
+			appendInt(&m.cmds, strlen(SPECTATOR_CMD));
+			append(&m.cmds, SPECTATOR_CMD, strlen(SPECTATOR_CMD));
+			m.numCmds++;
+			spectatorSync = 0;
+			break;
+		}
+	}
+
+	broadcast.num = 0;
+	appendInt(&broadcast, frame);
+	broadcast.add(numClients);
+	range(i, numClients) {
+		relayClient *c = clients[i];
+		if (!c) {
+			broadcast.add(-1);
+			continue;
+		}
+		broadcast.add(c->msgs.num);
+		range(j, c->msgs.num) {
+			relayMsg &m = c->msgs[j];
+			append(&broadcast, m.head.items, m.head.num);
+			broadcast.add(m.numCmds);
+			append(&broadcast, m.cmds.items, m.cmds.num);
+		}
+		if (c->msgs.num) c->missedFrames = 0;
+		else c->missedFrames++;
+		c->msgs.num = 0;
+		c->offsetsUsed[c->offsetsOffset] = 0;
+		c->offsetsOffset = (c->offsetsOffset + 1) % (MAX_AHEAD + 1);
+	}
+	frame = (frame + 1) % FRAME_ID_MAX;
+}
+
+static void sendBroadcast(int32_t sentFrame) {
+	int numClients = clients.num;
+	// Remote clients. The host (0) gets its copy separately.
+	for (int i = 1; i < numClients; i++) {
+		relayClient *c = clients[i];
+		if (!c) continue;
+		if (c->missedFrames >= MAX_MISSED_FRAMES) {
+			printf("Relay: closed client %d for not completing any messages for too long\n", i);
+			dropClient(i);
+			continue;
+		}
+		if (!c->inited) {
+			c->inited = 1;
+			char init[7] = {(char)MAGIC_FIRST_BYTE, (char)i, (char)numClients};
+			*(int32_t*)(init + 3) = htonl(sentFrame);
+			append(&c->out, init, 7);
+		}
+		append(&c->out, broadcast.items, broadcast.num);
+		if (flush(c)) dropClient(i);
+	}
+	for (int i = spectators.num - 1; i >= 0; i--) {
+		relayClient *c = spectators[i];
+		if (!c->inited) {
+			c->inited = 1;
+			char init[7] = {(char)MAGIC_FIRST_BYTE, (char)255, (char)numClients};
+			*(int32_t*)(init + 3) = htonl(sentFrame);
+			append(&c->out, init, 7);
+		}
+		append(&c->out, broadcast.items, broadcast.num);
+		if (flush(c)) dropSpectator(i);
+	}
+}
+
+static long nowNanos() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &t);
+	return t.tv_sec*1'000'000'000L + t.tv_nsec;
+}
+
+// Reads whatever's there. Returns 1 on hangup / error.
+static char readClient(relayClient *c) {
+	c->in.setMaxUp(c->in.num + 4096);
+	int ret = recv(c->fd, c->in.items + c->in.num, c->in.max - c->in.num, MSG_DONTWAIT);
+	if (ret == 0) return 1;
+	if (ret < 0) return errno != EAGAIN && errno != EWOULDBLOCK;
+	c->in.num += ret;
+	return 0;
+}
+
+static void* relayThreadFunc(void *arg) {
+	long target = nowNanos();
+	while (relayRunning) {
+		// [listen, spectator listen, clients 1.., spectators...]
+		fds.num = 0;
+		fds.add({.fd = listenFd, .events = POLLIN});
+		fds.add({.fd = spectatorFd, .events = POLLIN});
+		for (int i = 1; i < clients.num; i++) {
+			relayClient *c = clients[i];
+			short events = POLLIN | (c && c->out.num ? POLLOUT : 0);
+			fds.add({.fd = c ? c->fd : -1, .events = events});
+		}
+		rangeconst(i, spectators.num) {
+			relayClient *c = spectators[i];
+			// We don't care what spectators say, but we want to hear if they hang up
+			fds.add({.fd = c->fd, .events = (short)(POLLIN | (c->out.num ? POLLOUT : 0))});
+		}
+
+		long wait = target - nowNanos();
+		int ret = poll(fds.items, fds.num, wait > 0 ? (wait + 999'999) / 1'000'000 : 0);
+		if (ret == -1 && errno != EINTR) {
+			perror("relay poll");
+			break;
+		}
+		if (ret > 0) {
+			int numClients = clients.num;
+			for (int i = 1; i < numClients; i++) {
+				relayClient *c = clients[i];
+				short rev = fds[i+1].revents;
+				if (!c || !rev) continue;
+				char drop = (rev & (POLLERR | POLLHUP)) && !(rev & POLLIN);
+				if (!drop && (rev & POLLIN)) {
+					drop = readClient(c);
+					// We're the only one that changes `frame`, so no need to lock for this
+					if (!drop) drop = parseClient(c, i);
+				}
+				if (!drop && (rev & POLLOUT)) drop = flush(c);
+				if (drop) dropClient(i);
+			}
+			int specBase = 1 + numClients;
+			for (int i = spectators.num - 1; i >= 0; i--) {
+				relayClient *c = spectators[i];
+				short rev = fds[specBase + i].revents;
+				char drop = 0;
+				if (rev & POLLIN) {
+					drop = readClient(c);
+					c->in.num = 0;
+				} else if (rev & (POLLERR | POLLHUP)) {
+					drop = 1;
+				}
+				if (!drop && (rev & POLLOUT)) drop = flush(c);
+				if (drop) dropSpectator(i);
+			}
+			// Accepting last, since it messes with the lists we just indexed into
+			if (fds[0].revents & POLLIN) acceptOn(listenFd, 0);
+			if (fds[1].revents & POLLIN) acceptOn(spectatorFd, 1);
+		}
+
+		long now = nowNanos();
+		if (now < target) continue;
+		if (now - target > FRAME_NANOS) {
+			puts("Relay: missed a frame!");
+			target = now;
+		}
+		target += FRAME_NANOS;
+
+		mtx_lock(relayMutex);
+		int32_t sentFrame = frame;
+		tick();
+		mtx_unlock(relayMutex);
+
+		// Our own copy doesn't touch a socket. `net2_read` only looks at what's buffered,
+		// and this is always a complete frame, so it won't block.
+		if (net_feed(broadcast.items, broadcast.num) || net2_read()) {
+			// Can't go on without our own frames. Hang up on everyone so they find out now,
+			// and the game thread ends up waiting on a dead server, same as a normal client would.
+			puts("Relay: couldn't process our own broadcast, shutting down the relay");
+			mtx_lock(relayMutex);
+			relayFailed = 1;
+			mtx_unlock(relayMutex);
+			for (int i = 1; i < clients.num; i++) if (clients[i]) dropClient(i);
+			for (int i = spectators.num - 1; i >= 0; i--) dropSpectator(i);
+			break;
+		}
+		sendBroadcast(sentFrame);
+	}
+	return NULL;
+}
+
+static int openListener(int port) {
+	int fd = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		printf("Relay `socket` failed with: %s (%s)\n", strerrorname_np(errno), strerror(errno));
+		return -1;
+	}
+	int flag = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(int));
+	// IPv4 clients too, like server.py
+	flag = 0;
+	setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &flag, sizeof(int));
+	struct sockaddr_in6 address = {
+		.sin6_family = AF_INET6,
+		.sin6_port = htons(port),
+	};
+	address.sin6_addr = in6addr_any;
+	if (-1 == bind(fd, (struct sockaddr*)&address, sizeof(address)) || -1 == listen(fd, 5)) {
+		printf("Relay couldn't listen on port %d: %s (%s)\n", port, strerrorname_np(errno), strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+char relay_init(char const *port) {
+	int32_t portNum;
+	if (!getNum(&port, &portNum) || portNum <= 0 || portNum >= 65535) {
+		puts("Relay needs a numeric port");
+		return 1;
+	}
+	listenFd = openListener(portNum);
+	if (listenFd == -1) return 1;
+	spectatorFd = openListener(portNum + SPECTATOR_PORT_OFFSET);
+	if (spectatorFd == -1) {
+		net_close("relay listen socket", listenFd);
+		listenFd = -1;
+		return 1;
+	}
+	printf(QUIET_LINE("Relay listening on port %d (spectators on %d)"), portNum, portNum + SPECTATOR_PORT_OFFSET);
+
+	clients.init();
+	spectators.init();
+	broadcast.init();
+	fds.init();
+	hostClient = mkClient(-1);
+	clients.add(hostClient);
+	frame = 0;
+	relayFailed = 0;
+	return 0;
+}
+
+void relay_start() {
+	relayRunning = 1;
+	int ret = pthread_create(&relayThread, NULL, relayThreadFunc, NULL);
+	if (ret) {
+		printf("pthread_create returned %d for relayThread\n", ret);
+		relayRunning = 0;
+	}
+}
+
+void relay_hostSend(char const *data, int len) {
+	metric_bytesOut += len;
+	mtx_lock(relayMutex);
+	if (relayFailed) {
+		mtx_unlock(relayMutex);
+		return;
+	}
+	relayClient *c = hostClient;
+	append(&c->in, data, len);
+	if (parseClient(c, 0)) {
+		// Our own data, so this is a bug rather than somebody being nasty. Throw it out and carry on.
+		c->in.num = 0;
+	}
+	mtx_unlock(relayMutex);
+}
+
+void relay_destroy() {
+	if (relayRunning) {
+		relayRunning = 0;
+		// Poll never waits more than a frame, so this won't take long
+		pthread_join(relayThread, NULL);
+	}
+	range(i, clients.num) if (clients[i]) freeClient(clients[i]);
+	range(i, spectators.num) freeClient(spectators[i]);
+	clients.destroy();
+	hostClient = NULL;
+	spectators.destroy();
+	broadcast.destroy();
+	fds.destroy();
+	if (listenFd != -1) net_close("relay listen socket", listenFd);
+	if (spectatorFd != -1) net_close("relay spectator socket", spectatorFd);
+	listenFd = spectatorFd = -1;
+}
+
+#else
+
+#include <stdio.h>
+
+#include "relay.h"
+
+// Todo: Windows. The sockets are mostly the same, but it'd want `WSAPoll` and friends.
+char relay_init(char const *port) {
+	puts("Hosting (--listen) isn't supported on Windows yet");
+	return 1;
+}
+void relay_start() {}
+void relay_hostSend(char const *data, int len) {}
+void relay_destroy() {}
+
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+
+// Built-in stand-in for `server.py`, so the hosting player doesn't have to run it (`./game --listen [port]`).
+// Remote players and spectators connect over TCP as usual, but the host is slot 0 and its data
+// goes straight in and out of the relay in-process. Not on Windows (yet?).
+
+// Opens the listen sockets and sets the host up as client 0 of 1, starting at frame 0
+extern char relay_init(char const *port);
+// Starts the frame clock. Broadcasts are fed to `net2_read` on the relay's own thread,
+// so `net2_init` has to have happened first.
+extern void relay_start();
+// The host's outbound data, exactly as it would be sent to the server
+extern void relay_hostSend(char const *data, int len);
+extern void relay_destroy();
@@ -10,8 +10,9 @@
 #include "util.h"
 #include "serialize.h"
 
-char const *const seriz_versionString = "rTs0";
-int const seriz_latestVersion = 0;
+// Version 1: `constelInst`s have an aggregate velbox leaf, and their solids aren't serialized (or in the velbox tree) at all
+char const *const seriz_versionString = "rTs1";
+int const seriz_latestVersion = 1;
 
 // Some global state to make stuff easier.
 // Could put this in an object and pass it around if I really needed to,
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+
+#include "util.h"
+#include "list.h"
+
+// Fixed-size ring for handing items from exactly one producer thread
+// to exactly one consumer thread, without locks.
+// One slot is always left empty so `head == tail` unambiguously means "empty",
+// so it holds at most N-1 items at once.
+template <typename T, int N> struct spsc {
+	T items[N];
+	// `head` is only written by the consumer, `tail` only by the producer
+	std::atomic<int> head, tail;
+	void init();
+	// Returns 0 (and doesn't take `x`) if the ring is full
+	char push(T const &x);
+	// Returns 0 if there was nothing to pop
+	char pop(T *out);
+	// Pushes as much of `l` as fits, in order, and takes it off the front of `l`.
+	// Whatever's left stays in `l` for next time. Returns how many went in.
+	int pushSome(list<T> *l);
+};
+
+template <typename T, int N>
+void spsc<T, N>::init() {
+	head.store(0, std::memory_order::relaxed);
+	tail.store(0, std::memory_order::relaxed);
+}
+
+template <typename T, int N>
+char spsc<T, N>::push(T const &x) {
+	int t = tail.load(std::memory_order::relaxed);
+	int next = (t + 1) % N;
+	if (next == head.load(std::memory_order::acquire)) return 0;
+	items[t] = x;
+	tail.store(next, std::memory_order::release);
+	return 1;
+}
+
+template <typename T, int N>
+char spsc<T, N>::pop(T *out) {
+	int h = head.load(std::memory_order::relaxed);
+	if (h == tail.load(std::memory_order::acquire)) return 0;
+	*out = items[h];
+	head.store((h + 1) % N, std::memory_order::release);
+	return 1;
+}
+
+template <typename T, int N>
+int spsc<T, N>::pushSome(list<T> *l) {
+	int sent = 0;
+	while (sent < l->num && push((*l)[sent])) sent++;
+	if (sent) {
+		int left = l->num - sent;
+		range(i, left) (*l)[i] = (*l)[i + sent];
+		l->num = left;
+	}
+	return sent;
+}
+
+// Triple buffer, for handing the newest of a stream of T from one producer thread
+// to one consumer thread, without either side ever waiting on the other.
+// Items the consumer doesn't get to in time are just skipped.
+// The producer owns `back`, the consumer owns `front`, and the third slot is whatever index is in `middle`.
+// Each side hands off its slot by swapping it into `middle`.
+// TRIPLE_FRESH is set on `middle` when the producer put something there that the consumer hasn't taken yet.
+#define TRIPLE_FRESH 4
+template <typename T> struct triple {
+	T slots[3];
+	std::atomic<int> middle;
+	int back, front;
+	void init();
+	// Producer: fill in `slots[back]` and then call this.
+	// Returns 1 if that replaced one the consumer never took.
+	char publish();
+	// Consumer: `slots[front]` is the newest item afterwards.
+	// Returns 0 if nothing new came in (so `front` didn't change).
+	char take();
+};
+
+template <typename T>
+void triple<T>::init() {
+	front = 0;
+	middle.store(1, std::memory_order::relaxed);
+	back = 2;
+}
+
+template <typename T>
+char triple<T>::publish() {
+	int prev = middle.exchange(back | TRIPLE_FRESH, std::memory_order::acq_rel);
+	back = prev & 3;
+	return !!(prev & TRIPLE_FRESH);
+}
+
+template <typename T>
+char triple<T>::take() {
+	// Only we clear TRIPLE_FRESH, so if it's set here it'll still be set when we swap
+	if (!(middle.load(std::memory_order::relaxed) & TRIPLE_FRESH)) return 0;
+	int prev = middle.exchange(front, std::memory_order::acq_rel);
+	front = prev & 3;
+	return 1;
+}
@@ -0,0 +1,186 @@
+#ifndef _WIN32
+// Stress check for the lock-free game->render handoff (spsc.h), run as `./game --spsc-test [secs]`.
+// No window or network; one thread plays the game thread and one plays the render thread,
+// at mismatched rates (producer faster, then consumer faster), doing what `publishSnapshot`
+// and `checkRenderData` do. We check that:
+//  - every `ggc_msg` arrives, exactly once and in order, even when the ring fills up
+//  - a snapshot's messages have arrived by the time the snapshot has
+//  - snapshots never go backwards or arrive half-written
+//  - the overwritten / repeated counts add up to what actually happened
+// Prints "spsc test: OK" and returns 0, or complains and returns 1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <atomic>
+#include <pthread.h>
+
+#include "util.h"
+#include "list.h"
+#include "gamestate.h"
+#include "game_graphics.h"
+#include "spsc.h"
+
+#include "spsc_test.h"
+
+// Small, so the producer regularly has to hold messages back
+#define TEST_RING 16
+#define TEST_WORDS 64
+// Producer sends 0 to this many messages per tick
+#define TEST_MAX_MSGS 40
+
+struct testSlot {
+	// Every word is the snapshot's sequence number, so a torn read shows up as a mismatch
+	int words[TEST_WORDS];
+	// How many messages had gone into the ring when this was published
+	long msgsPushed;
+};
+
+static spsc<ggc_msg, TEST_RING> ring;
+static triple<testSlot> slots;
+static std::atomic<char> producing;
+static long testEndNanos;
+static int producerMicros, consumerMicros;
+
+// Producer's tallies
+static long published, overwritten, msgsSent;
+// Consumer's tallies. `repeated` is going by what `take` said, `distinct` is going by what we actually saw.
+static long repeated, distinct, frames, msgsReceived, lastSeq;
+static int failures;
+
+static long nowNanos() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec*1'000'000'000L + t.tv_nsec;
+}
+
+static void sleepMicros(int micros) {
+	timespec t = {.tv_sec = 0, .tv_nsec = micros*1000L};
+	nanosleep(&t, NULL);
+}
+
+static void fail(char const *what, long a, long b) {
+	if (failures++ < 10) printf("spsc test: %s (%ld vs %ld)\n", what, a, b);
+}
+
+static void* producerFunc(void *_arg) {
+	list<ggc_msg> pending;
+	pending.init();
+	long pushed = 0;
+	unsigned int seed = 1;
+	while (nowNanos() < testEndNanos) {
+		int n = rand_r(&seed) % (TEST_MAX_MSGS + 1);
+		range(i, n) {
+			ggc_msg &m = pending.add();
+			// Not a real message type, nobody's going to `ggcDestroy` these
+			m.type = msgsSent++;
+		}
+		pushed += ring.pushSome(&pending);
+
+		testSlot &s = slots.slots[slots.back];
+		range(i, TEST_WORDS) s.words[i] = published;
+		s.msgsPushed = pushed;
+		published++;
+		if (slots.publish()) overwritten++;
+
+		sleepMicros(producerMicros);
+	}
+	// Like the game thread, leftovers just go out on later ticks
+	while (pending.num) {
+		ring.pushSome(&pending);
+		sleepMicros(producerMicros);
+	}
+	pending.destroy();
+	producing.store(0, std::memory_order::release);
+	return NULL;
+}
+
+static void popAll() {
+	ggc_msg m;
+	while (ring.pop(&m)) {
+		if (m.type != msgsReceived) fail("message out of order", m.type, msgsReceived);
+		msgsReceived++;
+	}
+}
+
+static void consumeOne() {
+	frames++;
+	char fresh = slots.take();
+	popAll();
+	testSlot &s = slots.slots[slots.front];
+	int seq = s.words[0];
+	range(i, TEST_WORDS) {
+		if (s.words[i] != seq) {
+			fail("torn snapshot", s.words[i], seq);
+			break;
+		}
+	}
+	if (seq < lastSeq) fail("snapshot went backwards", seq, lastSeq);
+	if (seq != lastSeq) {
+		distinct++;
+		if (!fresh) fail("snapshot changed but `take` said it didn't", seq, lastSeq);
+		if (msgsReceived < s.msgsPushed) fail("snapshot beat its messages", msgsReceived, s.msgsPushed);
+	} else if (fresh) {
+		fail("`take` said fresh but it's the same snapshot", seq, lastSeq);
+	}
+	if (!fresh) repeated++;
+	lastSeq = seq;
+}
+
+static char runPhase(double secs, int pMicros, int cMicros) {
+	producerMicros = pMicros;
+	consumerMicros = cMicros;
+	ring.init();
+	slots.init();
+	// Slot 0 starts out as the consumer's, so give it something sensible
+	range(i, TEST_WORDS) slots.slots[slots.front].words[i] = -1;
+	slots.slots[slots.front].msgsPushed = 0;
+	published = overwritten = msgsSent = 0;
+	repeated = distinct = frames = msgsReceived = 0;
+	lastSeq = -1;
+	failures = 0;
+
+	producing.store(1, std::memory_order::relaxed);
+	testEndNanos = nowNanos() + (long)(secs * 1e9);
+	pthread_t producer;
+	if (pthread_create(&producer, NULL, producerFunc, NULL)) {
+		puts("spsc test: couldn't start producer thread");
+		return 1;
+	}
+	while (producing.load(std::memory_order::acquire)) {
+		consumeOne();
+		sleepMicros(consumerMicros);
+	}
+	pthread_join(producer, NULL);
+	// Producer's done, so this picks up the last snapshot (if we hadn't already) and the last messages
+	consumeOne();
+
+	if (msgsReceived != msgsSent) fail("messages lost", msgsReceived, msgsSent);
+	if (lastSeq != published - 1) fail("didn't end on the newest snapshot", lastSeq, published - 1);
+	// Every snapshot is either seen once or overwritten once, and every other frame is a repeat
+	if (overwritten != published - distinct) fail("overwritten count is off", overwritten, published - distinct);
+	if (repeated != frames - distinct) fail("repeated count is off", repeated, frames - distinct);
+
+	printf(
+		"spsc test: producer every %dus, consumer every %dus: %ld published, %ld seen, %ld overwritten, %ld repeated, %ld messages\n",
+		pMicros, cMicros, published, distinct, overwritten, repeated, msgsSent
+	);
+	return failures != 0;
+}
+
+int spsc_test(int argc, char **argv) {
+	double secs = argc > 0 ? atof(argv[0]) : 1;
+	if (secs <= 0) {
+		puts("Usage: ./game --spsc-test [seconds per phase]");
+		return 1;
+	}
+	char failed = 0;
+	failed |= runPhase(secs, 50, 300);
+	failed |= runPhase(secs, 300, 50);
+	// No sleeping at all, so the two really do run over top of each other
+	failed |= runPhase(secs, 0, 0);
+	puts(failed ? "spsc test: FAILED" : "spsc test: OK");
+	return failed;
+}
+
+#endif
@@ -0,0 +1,4 @@
+#pragma once
+
+// `argc` / `argv` are whatever came after "--spsc-test"
+extern int spsc_test(int argc, char **argv);
@@ -206,9 +206,8 @@ void tskBlast_draw(void *data, int32_t now) {
 
 		// TODO We're always rendering from tex 1 here,
 		//      maybe make texture selection its own call??
-		drawBillboard(p1, p2, 1, item.spr_x, item.spr_y, item.spr_w, 600);
+		queueBillboard(p1, p2, 1, item.spr_x, item.spr_y, item.spr_w, 600);
 	}
-	reset3dTexScale();
 }
 
 void defineTask_blast(taskDefn *d) {
@@ -65,6 +65,7 @@ static char step(gamestate *gs, void *_data) {
 	toCheck.init();
 	collisions.init();
 	p = velbox_query(p, data->s.m.oldPos, data->vel, 2000, &toCheck);
+	expandQueryResults(&toCheck, data->s.m.oldPos, data->vel, 2000);
 	offset total_vel = {0}, total_pos = {0};
 	offset total_rvel = {0}; // , total_turn = {0};
 	rangeconst(iter, toCheck.num) {
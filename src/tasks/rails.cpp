@@ -12,6 +12,7 @@ static tskRailsInstructions* mkInstr() {
 	tskRailsInstructions *instr = (tskRailsInstructions*)malloc(sizeof(tskRailsInstructions));
 	instr->refs = 1;
 	instr->pts.init();
+	instr->segs.init();
 	return instr;
 }
 
@@ -23,58 +24,99 @@ static void decr(tskRailsInstructions *instr) {
 	instr->refs--;
 	if (instr->refs) return;
 	instr->pts.destroy();
+	instr->segs.destroy();
 	free(instr);
 }
 
+static void buildSegs(tskRailsInstructions *instr) {
+	list<tskRailsPt> &pts = instr->pts;
+	instr->segs.setMaxUp(pts.num);
+	instr->segs.num = pts.num;
+	rangeconst(ic, pts.num) {
+		tskRailsPt &p1 = pts[ic];
+		tskRailsPt &p2 = pts[(ic+1)%pts.num];
+		tskRailsSeg &seg = instr->segs[ic];
+		int32_t duration = p2.time;
+		// Safety check; shouldn't happen.
+		if (duration < 1) duration = 1;
+		seg.duration = duration;
+
+		range(i, 3) {
+			int64_t delta = p2.pos[i] - p1.pos[i];
+			seg.vel[i] = delta / duration;
+			// Whatever doesn't divide evenly gets spread over the first few ticks,
+			// one unit per tick. Division rounds towards zero, so `rem` has the same sign as `delta`.
+			int64_t rem = delta - seg.vel[i]*duration;
+			seg.bump[i] = rem < 0 ? -1 : 1;
+			seg.bumpTicks[i] = rem*seg.bump[i];
+		}
+
+		seg.rotChanged = 0;
+		range(i, 4) seg.rotChanged |= (p1.rot[i] != p2.rot[i]);
+		if (!seg.rotChanged) continue;
+
+		// Compute rotation to get from orientation A to orientation B
+		iquat r1Inv;
+		r1Inv[0] =  p1.rot[0];
+		r1Inv[1] = -p1.rot[1];
+		r1Inv[2] = -p1.rot[2];
+		r1Inv[3] = -p1.rot[3];
+		iquat_mult(seg.difference, p2.rot, r1Inv);
+
+		// I'll be honest - I wrote most of this without knowing
+		// that the `w` in a quaternion could be negative. Turns
+		// out the interpolation gets weird in that case, but it
+		// looks like you can keep the "same" quaternion even if
+		// you flip the signs on everything!
+		if (seg.difference[0] < 0) range(i, 4) seg.difference[i] *= -1;
+
+		iquat &d = seg.difference;
+		seg.sinFull = sqrt(d[1]*d[1]+d[2]*d[2]+d[3]*d[3]);
+		// Same orientation, just with the signs flipped. Not worth interpolating (or dividing by zero).
+		if (!seg.sinFull) {
+			seg.rotChanged = 0;
+			continue;
+		}
+		seg.angle = shittyASin(seg.sinFull);
+	}
+}
+
 // `tskRails_timeHelper` currently depends on the gamestate being unused
 static char step(gamestate *_unused, void *_data) {
 	tskRailsData *data = (tskRailsData*)_data;
-	int numPts = data->instr->pts.num;
+	tskRailsInstructions *instr = data->instr;
+	int numPts = instr->pts.num;
 	if (!numPts) return 1;
 	constelInst *ci = data->ci;
 
 	int32_t time = data->time + 1;
 	int32_t ic = data->ic;
 	int32_t next = (ic+1)%numPts;
-	tskRailsPt &p1 = data->instr->pts[ic];
-	tskRailsPt &p2 = data->instr->pts[next];
-	int32_t duration = p2.time;
-	// Safety checks; shouldn't happen.
-	if (duration < 1) duration = 1;
+	tskRailsPt &p1 = instr->pts[ic];
+	tskRailsPt &p2 = instr->pts[next];
+	tskRailsSeg &seg = instr->segs[ic];
+	int32_t duration = seg.duration;
+	// Safety check; shouldn't happen.
 	if (time > duration) time = duration;
 
 	range(i, 3) ci->m.oldPos[i] = ci->m.pos[i];
 	range(i, 4) ci->m.oldRot[i] = ci->m.rot[i];
 
-	char rotChanged = 0;
-	range(i, 4) rotChanged |= (p1.rot[i] != p2.rot[i]);
-	if (!rotChanged) {
+	if (!seg.rotChanged) {
+		// Our velbox leaf is good until we hit the end of the segment,
+		// or until one of the axes runs out of `bump`.
 		ci->duration = duration - time + 1;
+		range(i, 3) {
+			if (time <= seg.bumpTicks[i] && seg.bumpTicks[i] - time + 1 < ci->duration) {
+				ci->duration = seg.bumpTicks[i] - time + 1;
+			}
+		}
 	} else if (time != duration) {
 		ci->duration = 1;
-		// Compute rotation to get from orientation A to orientation B
-		// (this is re-computed a lot - kind of a waste)
-		iquat r1Inv;
-		r1Inv[0] =  p1.rot[0];
-		r1Inv[1] = -p1.rot[1];
-		r1Inv[2] = -p1.rot[2];
-		r1Inv[3] = -p1.rot[3];
+		// Scale the rotation by the fraction `time/duration`.
 		iquat difference;
-		iquat_mult(difference, p2.rot, r1Inv);
-
-		// I'll be honest - I wrote most of this without knowing
-		// that the `w` in a quaternion could be negative. Turns
-		// out the interpolation gets weird in that case, but it
-		// looks like you can keep the "same" quaternion even if
-		// you flip the signs on everything!
-		if (difference[0] < 0) range(i, 4) difference[i] *= -1;
-
-		// Scale that rotation by the fraction `time/duration`.
-		// I feel like I could probably improve this (do I need 2 `sqrt`s?),
-		// but we'll roll with this for now.
-		int32_t sinFull = sqrt(difference[1]*difference[1]+difference[2]*difference[2]+difference[3]*difference[3]);
-		int32_t sinInterp = shittySin(shittyASin(sinFull)*time/duration);
-		range(i, 3) difference[i+1] = difference[i+1]*sinInterp/sinFull;
+		int32_t sinInterp = shittySin(seg.angle*time/duration);
+		range(i, 3) difference[i+1] = seg.difference[i+1]*sinInterp/seg.sinFull;
 		// We just take difference[0] to be "whatever's left",
 		// so it should be pretty normalized.
 		difference[0] = sqrt(
@@ -93,11 +135,12 @@ static char step(gamestate *_unused, void *_data) {
 		range(i, 4) ci->m.rot[i] = p2.rot[i];
 	}
 
-	// Todo: The velbox drifts at a constant speed,
-	//       but we interp our pos each time, so they could be out of sync!
-	offset delta;
-	range(i, 3) delta[i] = p2.pos[i] - p1.pos[i];
-	range(i, 3) ci->m.pos[i] = p1.pos[i] + delta[i]*time/duration;
+	// Whole units per tick (see `tskRailsSeg`), so this lands exactly on `p2.pos`
+	// at the end, and the velbox (which drifts at `pos - oldPos`) stays in sync.
+	range(i, 3) {
+		int32_t bumped = time < seg.bumpTicks[i] ? time : seg.bumpTicks[i];
+		ci->m.pos[i] = p1.pos[i] + seg.vel[i]*time + seg.bump[i]*bumped;
+	}
 
 	if (time >= p2.time) {
 		data->ic = next;
@@ -143,8 +186,9 @@ static char trans(gamestate *gs, void **ptr) {
 		write32(data->ci->clone.idx);
 	}
 	transInstructions(data->instr);
-	if (seriz_reading && data->instr->pts.num) {
-		data->ic = data->ic % data->instr->pts.num;
+	if (seriz_reading) {
+		if (data->instr->pts.num) data->ic = data->ic % data->instr->pts.num;
+		buildSegs(data->instr);
 	}
 	return 0;
 }
@@ -167,6 +211,16 @@ static void destroy(void *_data) {
 	free(data);
 }
 
+void tskRails_addPt(tskRailsInstructions *instr, offset const pos, iquat const rot, int32_t time) {
+	tskRailsPt &pt = instr->pts.add();
+	memcpy(pt.pos, pos, sizeof(offset));
+	memcpy(pt.rot, rot, sizeof(iquat));
+	pt.time = time;
+	// The new point changes the last segment too (it used to wrap around to the start),
+	// and routes are short, so we just redo the lot.
+	buildSegs(instr);
+}
+
 // This is intended for "mostly correct" time (like while messing with the editor),
 // it won't handle really really large numbers efficiently.
 void tskRails_timeHelper(tskRailsData *data) {
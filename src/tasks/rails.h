@@ -5,9 +5,28 @@ struct tskRailsPt {
 	int32_t time;
 };
 
+// Precomputed stuff for getting from `pts[i]` to `pts[i+1]`,
+// so `step` doesn't have to redo it every tick.
+struct tskRailsSeg {
+	int32_t duration;
+	char rotChanged;
+	// Rotation from the first orientation to the second
+	iquat difference;
+	// Magnitude of the axis part of `difference`, and the corresponding angle
+	int32_t sinFull, angle;
+	// Movement is a whole number of units each tick, so our velbox leaf
+	// can drift along with us exactly. Each axis moves `vel+bump` for the
+	// first `bumpTicks` ticks, and `vel` after that.
+	offset vel;
+	int32_t bump[3], bumpTicks[3];
+};
+
 struct tskRailsInstructions {
 	int refs;
 	list<tskRailsPt> pts;
+	// Derived from `pts`, and always kept up to date with it.
+	// Don't touch `pts` directly; go through `tskRails_addPt`.
+	list<tskRailsSeg> segs;
 };
 
 struct tskRailsData {
@@ -17,6 +36,7 @@ struct tskRailsData {
 	int32_t time;
 };
 
+extern void tskRails_addPt(tskRailsInstructions *instr, offset const pos, iquat const rot, int32_t time);
 extern void tskRails_timeHelper(tskRailsData *data);
 extern tskRailsData* tskRails_create(gamestate *gs, constelInst *ci);
 
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "list.h"
+#include "mtx.h"
+#include "png.h"
+
+#include "texload.h"
+
+#define TEXLOAD_THREADS 2
+
+struct texJob {
+	int layer, seq;
+	char path[200];
+};
+
+static int texRes;
+static pthread_t threads[TEXLOAD_THREADS];
+static mtx_t texloadMutex = MTX_INIT_EXPR;
+// Workers wait on `jobCond`, `texload_poll` waits on `doneCond`
+static cond_t jobCond = COND_INIT_EXPR;
+static cond_t doneCond = COND_INIT_EXPR;
+// Both of these are guarded by `texloadMutex`
+static list<texJob> jobs;
+static list<texload_result> done;
+// Requested but not yet handed out by `texload_poll`
+static int pending;
+static char running;
+
+static uint32_t* decode(texJob const &job) {
+	char *imageData;
+	int width, height;
+	png_read(&imageData, &width, &height, job.path);
+	if (!imageData) {
+		printf("Not loading texture %d\n", job.layer);
+		return NULL;
+	}
+	if (texRes % width || texRes % height) {
+		printf("Not loading texture %d, size %dx%d doesn't go evenly into %d\n", job.layer, width, height, texRes);
+		free(imageData);
+		return NULL;
+	}
+	// Everything in the array has to be the same size, so small stuff gets blown up.
+	// Our mag filter is GL_NEAREST anyway, so this looks the same as before.
+	uint32_t *src = (uint32_t*)imageData;
+	uint32_t *scaled = (uint32_t*)malloc(texRes*texRes*sizeof(uint32_t));
+	int fx = texRes/width, fy = texRes/height;
+	range(y, texRes) {
+		range(x, texRes) {
+			scaled[x + texRes*y] = src[x/fx + width*(y/fy)];
+		}
+	}
+	free(imageData);
+	return scaled;
+}
+
+static void* workerFunc(void *arg) {
+	mtx_lock(texloadMutex);
+	while (1) {
+		while (running && !jobs.num) mtx_wait(jobCond, texloadMutex);
+		if (!running) break;
+		// Oldest first, and `texload_poll` hands results back the same way, so textures show up
+		// roughly in the order they were asked for. (If a file gets reloaded twice, `seq` sorts it out.)
+		texJob job = jobs[0];
+		jobs.stableRmAt(0);
+		mtx_unlock(texloadMutex);
+
+		uint32_t *pixels = decode(job);
+
+		mtx_lock(texloadMutex);
+		done.add({.layer = job.layer, .seq = job.seq, .pixels = pixels});
+		mtx_signal(doneCond);
+	}
+	mtx_unlock(texloadMutex);
+	return NULL;
+}
+
+void texload_init(int res) {
+	texRes = res;
+	jobs.init();
+	done.init();
+	pending = 0;
+	running = 1;
+	range(i, TEXLOAD_THREADS) {
+		int ret = pthread_create(&threads[i], NULL, workerFunc, NULL);
+		if (ret) {
+			printf("pthread_create returned %d for texload thread\n", ret);
+			exit(1);
+		}
+	}
+}
+
+void texload_destroy() {
+	mtx_lock(texloadMutex);
+	running = 0;
+	pthread_cond_broadcast(&jobCond);
+	mtx_unlock(texloadMutex);
+	range(i, TEXLOAD_THREADS) pthread_join(threads[i], NULL);
+
+	rangeconst(i, done.num) free(done[i].pixels);
+	jobs.destroy();
+	done.destroy();
+}
+
+void texload_request(int layer, int seq, char const *path) {
+	mtx_lock(texloadMutex);
+	texJob &job = jobs.add();
+	job.layer = layer;
+	job.seq = seq;
+	snprintf(job.path, sizeof(job.path), "%s", path);
+	pending++;
+	mtx_signal(jobCond);
+	mtx_unlock(texloadMutex);
+}
+
+char texload_poll(texload_result *out, char wait) {
+	char ret = 0;
+	mtx_lock(texloadMutex);
+	if (wait) {
+		while (pending && !done.num) mtx_wait(doneCond, texloadMutex);
+	}
+	if (done.num) {
+		*out = done[0];
+		done.stableRmAt(0);
+		pending--;
+		ret = 1;
+	}
+	mtx_unlock(texloadMutex);
+	return ret;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+// PNG decoding on worker threads, so the render thread only has to upload.
+// Finished images are already scaled up (nearest-neighbor) to `res`x`res`.
+
+struct texload_result {
+	int layer;
+	// Whatever was passed to `texload_request`, so callers can spot stale results
+	int seq;
+	// `res`*`res` RGBA pixels, or NULL if the load failed. Caller frees.
+	uint32_t *pixels;
+};
+
+extern void texload_init(int res);
+extern void texload_destroy();
+extern void texload_request(int layer, int seq, char const *path);
+// Returns 0 if there was nothing finished. If `wait` is set, only returns 0 when nothing is pending at all.
+extern char texload_poll(texload_result *out, char wait);